@@ -13,36 +13,197 @@
 #include<string>
 #include<vector>
 #include<algorithm>
+#include<iterator> //reverse_iterator
 
 #include"node.h"
 #include"iterators.h"
+#include"balance.h"
+#include"pool.h"
+#include"frozen.h"
+#include"codec.h"
+#include"tasks.h"
 
 /**
  * \tparam Tk Type of node keys.
  * \tparam Tv Type of node values.
  * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ * \tparam Tb Balancing policy, either unbalanced or red_black, possibly augmented with order_statistics. Default is unbalanced.
+ * \tparam Ta Allocator of the pairs key-value, rebound to the nodes. Default is std::allocator, node_pool
+ * can be used to allocate the nodes from contiguous chunks of memory.
  */
-template<class Tk, class Tv, class Tc=std::less<Tk>>
+template<class Tk, class Tv, class Tc=std::less<Tk>, class Tb=unbalanced, class Ta=std::allocator<std::pair<const Tk,Tv>>>
 class BST
 {
 public:
 
   using pair = std::pair<const Tk,Tv>;
-  using Node = node<pair>;
+  using Deleter = typename node_deleter<Ta>::type;
+  using Node = node<pair, typename Tb::meta, Deleter>;
   using Iterator = iterator<Node, typename Node::value_type>;
   using Const_iterator = iterator<Node, const typename Node::value_type>;
+  using Reverse_iterator = std::reverse_iterator<Iterator>;
+  using Const_reverse_iterator = std::reverse_iterator<Const_iterator>;
+  using Alloc = typename std::allocator_traits<Ta>::template rebind_alloc<Node>;
+  using node_type = node_handle<Node>;
+
+  /**
+   * \brief Result of the insertion of a node handle.
+   */
+  struct insert_return_type
+  {
+    /** The node with the key of the handle, or end() if the handle was empty */
+    Iterator position;
+    /** True if the node has been linked in the tree */
+    bool inserted;
+    /** The node given back if the key was already in the tree, empty otherwise */
+    node_type node;
+  };
 
 private:
+  /** Allocator of the nodes, declared before the root so that it outlives the nodes */
+	Alloc alloc;
   /** Unique pointer to the root node */
-	std::unique_ptr<Node> root;
+	std::unique_ptr<Node,Deleter> root;
+  /** Nodes with the smallest and the biggest key, nullptr if the tree is empty */
+  Node* leftmost = nullptr;
+  Node* rightmost = nullptr;
+
+  /**
+   * \brief Functions that return an iterator to a node, which can be decremented from the end.
+   * \param n Node, nullptr for the end.
+   */
+  Iterator iter(Node* n) const noexcept { return Iterator{n, &rightmost}; }
+  Const_iterator citer(Node* n) const noexcept { return Const_iterator{n, &rightmost}; }
+
+  /**
+   * \brief Function that finds again the nodes with the smallest and the biggest key.
+   *
+   * It is used when the tree has been built without insert (copy and bulk load).
+   */
+  void findEnds() noexcept
+  {
+    leftmost = root ? root->findSmallest() : nullptr;
+    rightmost = root ? root->findLargest() : nullptr;
+  }
+
+  /**
+   * \brief Function that creates a new node.
+   * \param args Arguments forwarded to the constructor of the node.
+   * \return Node* The new node.
+   *
+   * Nodes are created with new if the allocator is std::allocator, by the allocator otherwise.
+   */
+  template<class... Args>
+  Node* newNode(Args&&... args);
+
+  /**
+   * \brief Function that destroys a node without children and gives its memory back.
+   * \param n Node to be deleted.
+   */
+  void deleteNode(Node* n) noexcept;
+
+  /**
+   * \brief Function that deletes all the nodes of a subtree.
+   * \param n Root of the subtree, already unlinked from the tree.
+   *
+   * The subtree is deleted with a loop: left children are rotated up until the current node
+   * has no left child, then the node is deleted and the loop goes on with its right child.
+   * It costs O(n) time and O(1) extra memory, whatever the shape of the subtree.
+   */
+  void destroy(Node* n) noexcept;
 
   /**
-    * \brief Recursive function for making a deep copy of a subtree.
-    * \param n root of the subtree to be copied.
+   * \brief Function that deletes all the nodes of the tree.
+   *
+   * For allocators which can release all their memory at once (node_pool) the nodes are only destroyed,
+   * or not visited at all if their data is trivially destructible, and then the whole pool is released.
+   */
+  void releaseNodes(std::false_type) noexcept { destroy(root.release()); }
+  void releaseNodes(std::true_type) noexcept;
+
+  /**
+   * \brief Function that makes room for a copy of a tree in contiguous memory, if the allocator is able to do it.
+   * \param tree Tree to be copied, its pool knows how many nodes it contains.
+   */
+  void reserveNodes(const BST&, std::false_type) noexcept {}
+  void reserveNodes(const BST& tree, std::true_type) { alloc.reserve(tree.alloc.size()); }
+
+  /**
+    * \brief Function for making a deep copy of a tree.
+    * \param tree Tree to be copied.
     *
+    * The copy has the same shape of the subtree and becomes the content of the (empty) tree:
+    * every node is cloned in one linear pass, without searching its position from the root.
+    * The subtree is visited in preorder with a loop which follows the parent pointers, so it does
+    * not use any stack even on degenerate trees. With node_pool the clones are allocated in
+    * a single contiguous chunk.
     * Private auxiliary function, used in the implementation of the copy semantics for the binary search tree.
     */
-  void copy(const std::unique_ptr<Node>& n);
+  void copy(const BST& tree);
+
+  /**
+   * \brief Function for making a deep copy of a tree with several threads.
+   * \param tree Tree to be copied.
+   * \param threads Number of threads.
+   *
+   * The top levels of the tree are cloned by recursive tasks of a task_pool, the subtrees below them are cloned
+   * by cloneSubtree. Nodes allocated by an allocator are always cloned by one thread, since allocators
+   * (node_pool among them) are not thread-safe.
+   */
+  void copy(const BST& tree, std::size_t threads);
+
+  /**
+   * \brief Function that clones a subtree with the loop of copy.
+   * \param source Root of the subtree to be cloned.
+   * \param slot Pointer which receives the clone, it owns the nodes as soon as they are created.
+   * \param parent Parent of the clone.
+   */
+  void cloneSubtree(const Node* source, std::unique_ptr<Node,Deleter>& slot, Node* parent);
+
+  /**
+   * \brief Function that clones a subtree, spawning a task for the left child of the nodes above a given depth.
+   * \param depth Number of levels still cloned by tasks.
+   */
+  void cloneParallel(const Node* source, std::unique_ptr<Node,Deleter>& slot, Node* parent, std::size_t depth, task_group& group);
+
+  /**
+   * \brief Function that returns the number of levels of the tree split in tasks when the work is shared by some threads.
+   */
+  static std::size_t taskDepth(std::size_t threads) noexcept
+  {
+    std::size_t depth = 3; //about 8 tasks per thread on a balanced tree
+    for(; threads > 1; threads /= 2) ++depth;
+    return depth;
+  }
+
+  /** Minimum number of nodes of a subtree relinked by a task of the parallel Balance */
+  static constexpr std::size_t task_cutoff = 1<<14;
+
+  /**
+   * \brief Function that splits the tree in chunks to be shared by some threads.
+   * \param threads Number of threads.
+   * \return std::vector<std::pair<Node*,bool>> In order, the nodes above the depth given by taskDepth (with false)
+   * and the roots of the subtrees at that depth (with true). With a single thread the whole tree is one chunk.
+   */
+  std::vector<std::pair<Node*,bool>> chunks(std::size_t threads) const;
+
+  /**
+   * \brief Function that visits the nodes of a subtree in order.
+   * \param n Root of the subtree.
+   * \param f Function called on every node.
+   */
+  template<class F>
+  static void visit(Node* n, F f);
+
+  /**
+   * \brief Function that processes the chunks of the tree with several threads.
+   * \param items Chunks returned by chunks(threads).
+   * \param threads Number of threads.
+   * \param f Function called with the index of every chunk: the subtrees are processed by tasks of a
+   * work-stealing pool, the single nodes by the calling thread.
+   */
+  template<class F>
+  void forChunks(const std::vector<std::pair<Node*,bool>>& items, std::size_t threads, F f) const;
 
   /**
    * \brief Private utility function which inserts a new node in the tree.
@@ -62,37 +223,498 @@ private:
    * an iterator pointing to the node containing that key if the key is not present it returns
    * an iterator pointing to the node in which the key should be inserted, if the tree is empty,
    * it returns a nullptr.
+   * The key can be of any type comparable with Tk by Tc, as the keys of all the following search functions.
+   */
+  template<class K>
+  Iterator findnode(const K& x) const;
+
+  /**
+   * \brief Private function which searches a key in the subtree rooted in the input node.
+   * \param current Node from which the search starts.
+   * \param x Key to be found.
+   * \return Node* The node with the input key if any, the node in which the key should be inserted
+   * otherwise, nullptr if current is nullptr.
+   */
+  template<class K>
+  Node* findFrom(Node* current, const K& x) const;
+
+  /**
+   * \brief Private function which returns the node with a key equivalent to the input key.
+   * \param x Key to be found.
+   * \return Node* The node, or nullptr if the key is not in the tree.
+   */
+  template<class K>
+  Node* findKey(const K& x) const;
+
+  /**
+   * \brief Private function which returns the first node whose key is not smaller than the input key.
+   * \param x Key to be searched.
+   * \return Node* The node, or nullptr if all the keys are smaller than x.
+   *
+   * It completes the search of findFrom: if the search ends on a smaller key, the result is its successor.
+   */
+  template<class K>
+  Node* lowerNode(const K& x) const;
+
+  /**
+   * \brief Private function which returns the first node whose key is bigger than the input key.
+   * \param x Key to be searched.
+   * \return Node* The node, or nullptr if no key is bigger than x.
+   */
+  template<class K>
+  Node* upperNode(const K& x) const;
+
+  /**
+   * \brief Private function which returns the bounds of the range of the keys equivalent to the input key.
+   * \param x Key to be searched.
+   * \return std::pair<Node*,Node*> The nodes of lower_bound and upper_bound, found with a single search.
+   */
+  template<class K>
+  std::pair<Node*, Node*> equalNodes(const K& x) const;
+
+  /**
+   * \brief Private function which erases the node with a key equivalent to the input key, if any.
+   * \param x Key to be erased.
+   */
+  template<class K>
+  void eraseKey(const K& x);
+
+  /**
+   * \brief Private function which climbs from a node to the first ancestor whose subtree may contain a key.
+   * \param finger Node where the search of a key not bigger than x has ended, nullptr to start from the root.
+   * \param x Key to be found.
+   * \return Node* Root of the smallest subtree, among the ancestors of finger, which may contain x.
+   *
+   * Searching increasing keys in this way only visits the part of the path which is not
+   * shared with the previous search.
+   */
+  Node* climb(Node* finger, const Tk& x) const;
+
+  /**
+   * \brief Private function which links a new node as a child of the node where a search ended.
+   * \param current Result of findFrom for the key.
+   * \param key Key of the new node.
+   * \param args Arguments of the constructor of the node (but the parent), used only if the key is not in the tree.
+   * \return std::pair<Iterator,bool> Pair formed by an iterator to the node with the key and a bool
+   * which is true if the node has been inserted.
+   */
+  template<class... Args>
+  std::pair<Iterator, bool> linkNode(Node* current, const Tk& key, Args&&... args);
+
+  /**
+   * \brief Private function which searches the position of a key next to a hint.
+   * \param hint Node before which the key should be, nullptr for the end.
+   * \param key Key to be searched.
+   * \return Node* A node which findFrom could return for the key: the node with the key, or a node with a free child
+   * where the key has to be linked.
+   *
+   * If the key is between the hint and its predecessor, the position is found in O(1) amortized time (the predecessor
+   * is found with a decrement), otherwise the search starts from the root.
+   */
+  Node* hintNode(Node* hint, const Tk& key) const;
+
+  /**
+   * \brief Private function which links a new node with a key and a value built from some arguments.
+   * \param current Result of the search of the key.
+   * \param k Key, forwarded to the node.
+   * \param args Arguments of the constructor of the value.
+   */
+  template<class K, class... Args>
+  std::pair<Iterator, bool> emplaceKey(Node* current, K&& k, Args&&... args)
+  {
+    return linkNode(current, k, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(k)),
+                    std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  /**
+   * \brief Private functions which link a node built from the arguments of emplace, after searching its key.
+   * \param search Function which returns the result of the search of a key (findnode or hintNode).
+   * \param args A key and a value, a pair, or the arguments of the constructor of a pair.
+   *
+   * A key and a value, or the members of a pair, are passed to emplaceKey, so that nothing is built if the key
+   * is already in the tree (a key of another type is converted to Tk first). Other arguments, such as
+   * std::piecewise_construct and two tuples, have to build the pair before its key can be searched.
+   */
+  template<class F, class K, class V>
+  std::pair<Iterator, bool> emplaceArgs(F search, K&& k, V&& v)
+  {
+    return emplaceArgs(search, typename std::is_same<typename std::decay<K>::type, Tk>::type{},
+                       std::forward<K>(k), std::forward<V>(v));
+  }
+  template<class F, class P>
+  std::pair<Iterator, bool> emplaceArgs(F search, P&& p)
+  { return emplaceArgs(search, std::forward<P>(p).first, std::forward<P>(p).second); }
+  template<class F, class... Types>
+  std::pair<Iterator, bool> emplaceArgs(F search, Types&&... args)
+  {
+    pair p(std::forward<Types>(args)...);
+    return linkNode(search(p.first), p.first, std::move(p));
+  }
+  template<class F, class K, class V>
+  std::pair<Iterator, bool> emplaceArgs(F search, std::true_type, K&& k, V&& v)
+  { return emplaceKey(search(k), std::forward<K>(k), std::forward<V>(v)); }
+  template<class F, class K, class V>
+  std::pair<Iterator, bool> emplaceArgs(F search, std::false_type, K&& k, V&& v)
+  {
+    Tk key(std::forward<K>(k));
+    return emplaceKey(search(key), std::move(key), std::forward<V>(v));
+  }
+
+  /**
+   * \brief Private function which links a single node as a child of the node where a search ended.
+   * \param current Result of findFrom for the key of n, nullptr if the tree is empty.
+   * \param n Node to be linked, with no children.
+   * \param left True if n becomes the left child of current.
+   *
+   * It updates the extremes, the sizes and the links of the tree and restores the balancing invariants.
+   */
+  void attachNode(Node* current, Node* n, const bool left) noexcept;
+
+  /**
+   * \brief Private function which returns the indices of a batch of keys in increasing key order.
+   * \param keys Batch of keys.
+   * \return std::vector<std::size_t> Indices of the keys, equal keys are kept in their original order.
+   */
+  std::vector<std::size_t> sortedOrder(const std::vector<Tk>& keys) const;
+
+  /**
+   * \brief Private function which finds a batch of keys in increasing order, starting every search from the previous one.
+   * \param keys Batch of keys.
+   * \return std::vector<Node*> For every key (in the original order) the node containing it, or nullptr.
+   */
+  std::vector<Node*> findSorted(const std::vector<Tk>& keys) const;
+
+  /**
+   * \brief Private function which turns the tree into a vine, i.e. a tree in which no node has a left child.
+   * \return std::size_t Number of nodes in the tree.
+   *
+   * The vine is obtained by means of right rotations, so it costs O(n) time and O(1) extra memory.
+   */
+  std::size_t treeToVine() noexcept;
+
+  /**
+   * \brief Private function which performs a left rotation on every other node of the right spine of the tree.
+   * \param count Number of rotations to be performed.
+   * \param bottom True if the nodes rotated down are the ones of the last (incomplete) level of the balanced tree.
+   */
+  void compress(std::size_t count, const bool bottom) noexcept;
+
+  /**
+   * \brief Recursive function which builds a balanced tree from a sorted sequence of pairs.
+   * \param first Iterator to the next pair of the sequence, it is advanced past the pairs used.
+   * \param count Number of pairs to be used.
+   * \param depth Depth of the root of the subtree.
+   * \param bottom Depth of the last level of the tree, whose nodes are red in a red-black tree.
+   * \return std::unique_ptr<Node> Root of the subtree.
+   *
+   * The left half of the pairs builds the left subtree, the median becomes the root and the right half
+   * builds the right subtree. Every pair is used once, in order, so the cost is O(n).
+   */
+  template<class It>
+  std::unique_ptr<Node,Deleter> buildtree(It& first, std::size_t count, std::size_t depth, std::size_t bottom);
+
+  /**
+   * \brief Function which replaces the content of the tree with a range which is known to be sorted.
+   * \param first Beginning of the range.
+   * \param count Number of pairs in the range.
+   */
+  template<class It>
+  void assignSorted(It first, std::size_t count);
+
+  /**
+   * \brief Function that returns the depth of the last level of a balanced tree with count nodes, if it is not complete.
+   */
+  static std::size_t bottomLevel(std::size_t count) noexcept;
+
+  /**
+   * \brief Function that relinks a sorted sequence of nodes as a balanced subtree, like buildtree does with pairs.
+   * \param nodes Nodes of the subtree in order, their children are released and replaced.
+   * \param count Number of nodes.
+   * \param depth Depth of the root of the subtree.
+   * \param bottom Depth of the last level of the tree.
+   * \param parent Parent of the root of the subtree.
+   * \param group Group in which the left halves bigger than task_cutoff are spawned, nullptr for a single thread.
+   * \return Node* Root of the subtree.
+   */
+  Node* relink(Node** nodes, std::size_t count, std::size_t depth, std::size_t bottom, Node* parent, task_group* group) noexcept;
+
+  /**
+   * \brief Functions which replace the content of the tree with a range, dispatched on the iterator category.
+   *
+   * Single pass ranges are always copied in a buffer, other ranges are checked and used directly if
+   * their keys are already strictly increasing.
+   */
+  template<class It>
+  void assignRange(It first, It last, std::input_iterator_tag);
+  template<class It>
+  void assignRange(It first, It last, std::forward_iterator_tag);
+
+  /**
+   * \brief Function that sets the colour of a node, if the balancing policy stores it.
+   * \param n Node to be coloured.
+   * \param red Colour of the node.
+   */
+  void recolour(Node*, const bool, unbalanced) noexcept {}
+  void recolour(Node* n, const bool red, red_black) noexcept { n->red = red; }
+
+  /** True if the nodes store the size of their subtree */
+  using sized = has_size<Tb>;
+
+  /**
+   * \brief Function that returns the number of nodes of a subtree, if the nodes store it.
+   * \param n Root of the subtree, possibly nullptr.
+   */
+  static std::size_t sizeOf(const Node* n) noexcept { return n ? n->size : 0; }
+
+  /**
+   * \brief Function that sets the size of the subtree of a node, if the policy stores it.
+   * \param n Node.
+   * \param count Number of nodes of its subtree.
+   */
+  void setSize(Node*, const std::size_t, std::false_type) noexcept {}
+  void setSize(Node* n, const std::size_t count, std::true_type) noexcept { n->size = count; }
+
+  /**
+   * \brief Function that adds or removes a node from the sizes of the subtrees of a node and of its ancestors.
+   * \param n First node to be updated, possibly nullptr.
+   * \param grow True if a node has been linked, false if it has been unlinked.
+   */
+  void resizePath(Node*, const bool, std::false_type) noexcept {}
+  void resizePath(Node* n, const bool grow, std::true_type) noexcept
+  {
+    for(; n; n = n->parent)
+      n->size = grow ? n->size+1 : n->size-1;
+  }
+
+  /**
+   * \brief Function that fixes the sizes after a rotation.
+   * \param x Node which has been rotated down.
+   * \param y Node which took its place.
+   */
+  void rotated(Node*, Node*, std::false_type) noexcept {}
+  void rotated(Node* x, Node* y, std::true_type) noexcept
+  {
+    y->size = x->size;
+    x->size = 1 + sizeOf(x->left.get()) + sizeOf(x->right.get());
+  }
+
+  /** True if the nodes are linked in key order */
+  using linked = is_threaded<Node>;
+
+  /**
+   * \brief Function that links a new node to its neighbours in key order, if the policy stores the links.
+   * \param n Node just linked in the tree as a leaf.
+   */
+  void threadNode(Node*, std::false_type) noexcept {}
+  void threadNode(Node* n, std::true_type) noexcept;
+
+  /**
+   * \brief Function that unlinks a node from its neighbours in key order, if the policy stores the links.
+   * \param n Node being removed.
+   */
+  void unthreadNode(Node*, std::false_type) noexcept {}
+  void unthreadNode(Node* n, std::true_type) noexcept
+  {
+    if(n->prev) n->prev->next = n->next;
+    if(n->next) n->next->prev = n->prev;
+  }
+
+  /**
+   * \brief Function that keeps the links of two nodes where they are when their meta data are swapped.
+   */
+  void keepLinks(Node*, Node*, std::false_type) noexcept {}
+  void keepLinks(Node* x, Node* y, std::true_type) noexcept
+  { std::swap(static_cast<thread_links&>(*x), static_cast<thread_links&>(*y)); }
+
+  /**
+   * \brief Function that links all the nodes of the tree in key order, if the policy stores the links.
+   *
+   * It is used after the nodes have been created without searching their position (copy and bulk load),
+   * with one in-order visit of the tree which follows the parent pointers.
+   */
+  void threadTree(std::false_type) noexcept {}
+  void threadTree(std::true_type) noexcept;
+
+  /**
+   * \brief Function that counts the nodes of the tree.
+   *
+   * The overload for sized trees reads the size of the root, the other one visits the tree.
+   */
+  std::size_t countNodes(std::true_type) const noexcept { return sizeOf(root.get()); }
+  std::size_t countNodes(std::false_type) const noexcept
+  {
+    std::size_t count = 0;
+    for(auto it = cbegin(); it != cend(); ++it)
+      ++count;
+    return count;
+  }
+
+  /**
+   * \brief Function that returns the node with the k-th smallest key.
+   * \param k Position of the node, from 0.
+   * \return Node* The node, or nullptr if the tree has at most k nodes.
+   */
+  Node* selectNode(std::size_t k) const noexcept;
+
+  /**
+   * \brief Function that returns the position of a node in the ordered sequence of the keys.
+   * \param n Node of the tree, or nullptr for the end of the sequence.
+   */
+  std::size_t position(const Node* n) const noexcept;
+
+  /**
+   * \brief Function that returns the unique_ptr owning the input node.
+   * \param n Node of the tree.
+   * \return std::unique_ptr<Node,Deleter>& The root if n is the root, the proper child of its parent otherwise.
+   */
+  std::unique_ptr<Node,Deleter>& slot(Node* n) noexcept
+  { return n->parent ? (n->parent->left.get()==n ? n->parent->left : n->parent->right) : root; }
+
+  /**
+   * \brief Function that rotates the subtree rooted in the input node to the left.
+   * \param x Node whose right child takes its place.
+   */
+  void rotateLeft(Node* x) noexcept;
+
+  /**
+   * \brief Function that rotates the subtree rooted in the input node to the right.
+   * \param x Node whose left child takes its place.
+   */
+  void rotateRight(Node* x) noexcept;
+
+  /**
+   * \brief Function that restores the balancing invariants after a node has been linked in the tree.
+   * \param n Node just inserted.
+   *
+   * \return bool True if the black height of the tree has grown.
+   *
+   * The overload for the unbalanced policy does nothing, the one for the red_black policy
+   * recolours and rotates the nodes on the path from n to the root.
+   */
+  bool insertFixup(Node*, unbalanced) noexcept { return false; }
+  bool insertFixup(Node* n, red_black) noexcept;
+
+  /**
+   * \brief Function that restores the balancing invariants after a node has been unlinked from the tree.
+   * \param x Node that took the place of the removed one, possibly nullptr.
+   * \param xp Parent of x.
+   * \param removed Node which has been unlinked, it carries the colour of the removed position.
+   */
+  void eraseFixup(Node*, Node*, Node*, unbalanced) noexcept {}
+  void eraseFixup(Node* x, Node* xp, Node* removed, red_black) noexcept;
+
+  /**
+   * \brief Function that unlinks a node from the tree.
+   * \param z Node to be unlinked, it is left with no parent, no children and the meta data of a new node.
+   *
+   * If z has two children it is replaced by its inorder successor, which is moved (not copied) in the position of z.
+   * The addresses of all the other nodes of the tree stay valid.
+   */
+  void unlinkNode(Node* z) noexcept;
+
+  /**
+   * \brief Function that unlinks a node from the tree and deletes it.
+   * \param z Node to be deleted.
+   */
+  void eraseNode(Node* z) noexcept
+  {
+    unlinkNode(z);
+    deleteNode(z);
+  }
+
+  /**
+   * \brief Function that returns the number of black nodes on the paths from the root to the leaves, 0 if the tree is not red-black.
+   *
+   * It walks down the left spine, so it costs O(h).
+   */
+  int blackHeight() const noexcept { return blackHeight(Tb{}); }
+  int blackHeight(unbalanced) const noexcept { return 0; }
+  int blackHeight(red_black) const noexcept
+  {
+    int h = 0;
+    for(Node* n = root.get(); n; n = n->left.get())
+      h += !n->red;
+    return h;
+  }
+
+  /**
+   * \brief Function that returns 1 if a node is black, 0 if it is red or the tree is not red-black.
+   */
+  static int blackOf(const Node*, unbalanced) noexcept { return 0; }
+  static int blackOf(const Node* n, red_black) noexcept { return !n->red; }
+
+  /**
+   * \brief Function that colours black the root of a subtree, if it is red.
+   * \return int 1 if the black height of the subtree has grown, 0 otherwise.
    */
-  Iterator findnode(const Tk& x) const;
+  static int blacken(Node*, unbalanced) noexcept { return 0; }
+  static int blacken(Node* n, red_black) noexcept
+  {
+    if(!n || !n->red) return 0;
+    n->red = false;
+    return 1;
+  }
 
   /**
-   * \brief Recursive utility function which builds a tree from a vector of pairs.
-   * \param values Vector containing the key-value pairs of the current tree.
-   * \param start First element of the input vector, useful for recursion.
-   * \param end Last element of the input vector, useful for recursion.
+   * \brief Function that sets the size of the subtree of a node from the sizes of its children.
    */
-  void rebuildtree (std::vector<std::pair<Tk, Tv>>& values, int start, int end);
+  void sumSize(Node*, std::false_type) noexcept {}
+  void sumSize(Node* n, std::true_type) noexcept
+  { n->size = 1 + sizeOf(n->left.get()) + sizeOf(n->right.get()); }
 
   /**
-   * \brief Private auxiliary function which stores all the pairs key-value contained
-   * in the nodes of the tree in a vector.
-   * \return std::vector<pair> Vector containing pairs key-value.
+   * \brief Function that adds a node and a subtree to the sizes of the subtrees of a node and of its ancestors.
+   * \param n First node to be updated, possibly nullptr.
+   * \param sub Subtree linked below n together with a new node, possibly nullptr.
    */
-  std::vector<std::pair<Tk, Tv>> BalancePrivate();
+  void growPath(Node*, const Node*, std::false_type) noexcept {}
+  void growPath(Node* n, const Node* sub, std::true_type) noexcept
+  {
+    const std::size_t count = sizeOf(sub) + 1;
+    for(; n; n = n->parent)
+      n->size += count;
+  }
 
   /**
-   * \brief Function that removes the root of the tree and properly sets a new one.
+   * \brief Function that joins the tree with a node and a tree of bigger keys.
+   * \param k Detached node, whose key is between the two trees.
+   * \param b Detached root of the tree of bigger keys, possibly nullptr.
+   * \param ha Black height of the tree.
+   * \param hb Black height of the tree rooted in b.
+   * \return int Black height of the joined tree, which becomes the content of the tree.
+   *
+   * Without balancing, k becomes the root with the two trees as children. In a red-black tree k is linked as a red node
+   * at the level of the spine of the taller tree where the black height of the other tree is reached, and
+   * insertFixup restores the invariants: the cost is O(|ha-hb|+1).
    */
-  void RemoveRootMach();
+  int joinAt(Node* k, Node* b, int ha, int hb, unbalanced) noexcept;
+  int joinAt(Node* k, Node* b, int ha, int hb, red_black) noexcept;
 
   /**
-   * \brief Function that delete a non-root node and reassemble the tree following the rules of the binary tree.
-   * \param parent Parent node of the node to delete.
-   * \param match Node to be deleted.
-   * \param left Boolean which is true if the node to be deleted is the left child of its parent, false otherwise.
+   * \brief Function that cuts the links in key order before a node, if the policy stores them.
+   * \param n First node of the part of the tree being split off, possibly nullptr.
    */
+  void cutLinks(Node*, std::false_type) noexcept {}
+  void cutLinks(Node* n, std::true_type) noexcept
+  {
+    if(n && n->prev)
+    {
+      n->prev->next = nullptr;
+      n->prev = nullptr;
+    }
+  }
 
-  void RemoveMatch(Node* parent, Node* match, const bool left);
+  /**
+   * \brief Function that links two consecutive nodes in key order, if the policy stores the links.
+   * \param a First node, possibly nullptr.
+   * \param b Second node, possibly nullptr.
+   */
+  void joinLinks(Node*, Node*, std::false_type) noexcept {}
+  void joinLinks(Node* a, Node* b, std::true_type) noexcept
+  {
+    if(a) a->next = b;
+    if(b) b->prev = a;
+  }
 
 	#ifdef PRINT
   /**
@@ -100,7 +722,7 @@ private:
    * \param n Node of which the function prints the stored data.
    * \param os Stream to which the nodes are sent.
    */
-  void printNode(const std::unique_ptr<Node>& n, std::ostream& os) const noexcept;
+  void printNode(const std::unique_ptr<Node,Deleter>& n, std::ostream& os) const noexcept;
 
   /**
    * \brief Private function used to print the structure of the tree.
@@ -109,7 +731,7 @@ private:
    * \param nleft Boolean specifying if the input node is left child.
    * \param os Stream to which the nodes are sent.
    */
-  void printBST(const std::string& prefix, const std::unique_ptr<Node>& n, const bool nleft, std::ostream& os) const noexcept;
+  void printBST(const std::string& prefix, const std::unique_ptr<Node,Deleter>& n, const bool nleft, std::ostream& os) const noexcept;
   #endif
 
 public:
@@ -122,14 +744,32 @@ public:
 	 */
 	BST() = default;
 
+	/**
+	 * \brief Range constructor.
+	 * \param first Beginning of a range of key-value pairs.
+	 * \param last End of the range.
+	 * \param cmp Comparison operator.
+	 *
+	 * Constructs a perfectly balanced tree from the range, see assign.
+	 */
+	template<class It, class = typename std::iterator_traits<It>::iterator_category>
+	BST(It first, It last, Tc cmp=Tc{})
+	: comp{cmp}
+	{
+	  assign(first, last);
+	}
+
 	/**
 	 * \brief Custom custroctor.
 	 *
 	 * Constructs a binary search tree given the root node data.
 	 */
 	BST(pair newRoot, Tc cmp=Tc{})
-	: root{new Node{newRoot}}, comp{cmp}
+	: root{nullptr}, comp{cmp}
 	{
+	  root.reset(newNode(newRoot, nullptr));
+	  insertFixup(root.get(), Tb{});
+	  leftmost = rightmost = root.get();
 	  #ifdef TEST
 	  std::cout<<"custom ctor"<<std::endl;
 	  #endif
@@ -140,17 +780,32 @@ public:
 	 * \param tree Binary Search Tree to be copied.
    *
 	 * This constructor creates a binary search tree copying the content of
-	 * the tree in input, taking advantage of the private recursive copy
-	 * function.
+	 * the tree in input, taking advantage of the private copy
+	 * function, which clones the tree in linear time.
 	 */
 	 BST(const BST& tree)
+	 : alloc{std::allocator_traits<Alloc>::select_on_container_copy_construction(tree.alloc)}, comp{tree.comp}
 	 {
-	  copy(tree.root);
+	  copy(tree);
 	  #ifdef TEST
 	  std::cout<<"copy ctor"<<std::endl;
 	  #endif
 	 }
 
+	/**
+	 * \brief Copy constructor using several threads.
+	 * \param tree Binary Search Tree to be copied.
+	 * \param threads Number of threads, 1 for the sequential copy.
+	 *
+	 * Disjoint subtrees are cloned in parallel by the tasks of a work-stealing pool. With an allocator other than
+	 * std::allocator the copy is sequential.
+	 */
+	 BST(const BST& tree, std::size_t threads)
+	 : alloc{std::allocator_traits<Alloc>::select_on_container_copy_construction(tree.alloc)}, comp{tree.comp}
+	 {
+	  copy(tree, threads);
+	 }
+
 	/**
          * \brief Copy assignment.
          * \param tree binary search tree to be copied.
@@ -165,8 +820,10 @@ public:
          * This constructor creates a binary search tree moving the content of the
          * tree in input.
          */
-	BST(BST&& tree) noexcept : root{std::move(tree.root)}
+	BST(BST&& tree) noexcept : alloc{std::move(tree.alloc)}, root{std::move(tree.root)}, comp{std::move(tree.comp)}
 	{
+	  std::swap(leftmost, tree.leftmost);
+	  std::swap(rightmost, tree.rightmost);
 	  #ifdef TEST
           std::cout<<"move ctor"<<std::endl;
 	  #endif
@@ -182,19 +839,23 @@ public:
        /**
         * \brief Function to clear the content of the tree.
         *
-        * This function resets the root of the tree, so that the whole tree is destroyed without any memory leak.
+        * This function deletes all the nodes of the tree, so that the whole tree is destroyed without any memory leak.
+        * With node_pool the memory is given back in a time proportional to the number of chunks.
         */
        void clear() noexcept
        {
      	 #ifdef TEST
      	 std::cout<<"deleting the tree"<<std::endl;
      	 #endif
-     	 root.reset();
+     	 releaseNodes(is_arena<Alloc>{});
+     	 leftmost = rightmost = nullptr;
         }
 
   	/**
          * \brief Function used to start iterations on the tree.
          * \return Iterator An iterator pointing to the leftmost node of the tree, the one with the smallest key.
+         *
+         * The leftmost node is kept by the tree, so it costs O(1).
          */
   	Iterator begin() noexcept;
 
@@ -202,7 +863,7 @@ public:
          * \brief Function used to finish an iteration on the tree.
          * \return Iterator An iterator pointing to one past the last element of the tree.
          */
-  	Iterator end() noexcept { return Iterator{nullptr}; }
+  	Iterator end() noexcept { return iter(nullptr); }
 
         /**
          * \brief Function used to start iterations on the tree.
@@ -223,7 +884,7 @@ public:
          * the last element of the tree.
          */
   	Const_iterator end() const noexcept
-  		{ return Const_iterator{nullptr};}
+  		{ return citer(nullptr);}
 
         /**
          * \brief Function used to finish an iteration on the tree.
@@ -231,7 +892,25 @@ public:
          * the last element of the tree.
          */
   	Const_iterator cend() const noexcept
-  		{ return Const_iterator{nullptr};}
+  		{ return citer(nullptr);}
+
+        /**
+         * \brief Functions used to start an iteration on the tree in descending key order.
+         * \return Reverse_iterator A reverse iterator pointing to the node with the biggest key.
+         *
+         * The biggest node is kept by the tree, so the end is decremented in O(1).
+         */
+  	Reverse_iterator rbegin() noexcept { return Reverse_iterator{end()}; }
+  	Const_reverse_iterator rbegin() const noexcept { return Const_reverse_iterator{end()}; }
+  	Const_reverse_iterator crbegin() const noexcept { return Const_reverse_iterator{cend()}; }
+
+        /**
+         * \brief Functions used to finish an iteration on the tree in descending key order.
+         * \return Reverse_iterator A reverse iterator pointing to one before the node with the smallest key.
+         */
+  	Reverse_iterator rend() noexcept { return Reverse_iterator{begin()}; }
+  	Const_reverse_iterator rend() const noexcept { return Const_reverse_iterator{begin()}; }
+  	Const_reverse_iterator crend() const noexcept { return Const_reverse_iterator{cbegin()}; }
 
         /**
          * \brief This function inserts a new node into the BST.
@@ -256,6 +935,9 @@ public:
          * \param args A key-value pair.
          * \return std::pair<Itearator, bool> It returns a pair: an iterator that points to the node
          * and a bool value which is true if the function insert the node, false if the node is already in the BST.
+         *
+         * When the arguments are a key and a value, or a pair, the key is searched first and the pair is built
+         * directly in the new node, only if the key is not in the tree.
          */
        template<typename... Types>
        std::pair<Iterator, bool> emplace(Types&&... args)
@@ -263,9 +945,132 @@ public:
          #ifdef TEST
          std::cout<<"Emplace"<<std::endl;
          #endif
-         return insert(std::make_pair<const Tk,Tv>(std::forward<Types>(args)...));
+         return emplaceArgs([this](const Tk& k){ return findnode(k).node(); }, std::forward<Types>(args)...);
+       }
+
+       /**
+        * \brief This function inserts a pair whose value is built in place, if the key is not in the tree.
+        * \param k Key of the pair.
+        * \param args Arguments of the constructor of the value.
+        * \return std::pair<Iterator,bool> The node with the key and true if it has been inserted.
+        *
+        * Unlike emplace, nothing is built if the key is already in the tree: the value is constructed directly
+        * in the new node after the search, and the key is moved in it only then.
+        */
+       template<class... Args>
+       std::pair<Iterator, bool> try_emplace(const Tk& k, Args&&... args)
+       { return emplaceKey(findnode(k).node(), k, std::forward<Args>(args)...); }
+       template<class... Args>
+       std::pair<Iterator, bool> try_emplace(Tk&& k, Args&&... args)
+       { return emplaceKey(findnode(k).node(), std::move(k), std::forward<Args>(args)...); }
+
+       /**
+        * \brief This function inserts a pair whose value is built in place, searching its position next to a hint.
+        * \param hint Position before which the key should be, see insert with a hint.
+        * \return Iterator The node with the key.
+        */
+       template<class... Args>
+       Iterator try_emplace(Const_iterator hint, const Tk& k, Args&&... args)
+       { return emplaceKey(hintNode(hint.node(), k), k, std::forward<Args>(args)...).first; }
+       template<class... Args>
+       Iterator try_emplace(Const_iterator hint, Tk&& k, Args&&... args)
+       { return emplaceKey(hintNode(hint.node(), k), std::move(k), std::forward<Args>(args)...).first; }
+
+       /**
+        * \brief This function inserts a pair, or assigns the value of the pair with the same key.
+        * \param k Key of the pair.
+        * \param obj Value to be assigned or inserted.
+        * \return std::pair<Iterator,bool> The node with the key and true if it has been inserted, false if it has been assigned.
+        */
+       template<class M>
+       std::pair<Iterator, bool> insert_or_assign(const Tk& k, M&& obj);
+       template<class M>
+       std::pair<Iterator, bool> insert_or_assign(Tk&& k, M&& obj);
+
+       /**
+        * \brief This function inserts a pair, searching its position next to a hint.
+        * \param hint Position before which the key should be: the node with the next key, or end() if it is the biggest.
+        * \param x Pair to be inserted.
+        * \return Iterator The node with the key of x, inserted or already in the tree.
+        *
+        * If the hint is right, the position is found in O(1) amortized time, and in the red-black tree also the fixup
+        * is O(1) amortized: appending keys in increasing order with end() as hint costs O(1) amortized per key
+        * (O(h) with order_statistics, which updates the sizes up to the root). A wrong hint costs a normal search.
+        */
+       Iterator insert(Const_iterator hint, const pair& x)
+       { return linkNode(hintNode(hint.node(), x.first), x.first, x).first; }
+       Iterator insert(Const_iterator hint, pair&& x)
+       { return linkNode(hintNode(hint.node(), x.first), x.first, std::move(x)).first; }
+
+       /**
+        * \brief This function inserts a pair built from the arguments, searching its position next to a hint.
+        * \param hint Position before which the key should be, see insert with a hint.
+        * \param args A key and a value.
+        */
+       template<typename... Types>
+       Iterator emplace_hint(Const_iterator hint, Types&&... args)
+       {
+         return emplaceArgs([this, hint](const Tk& k){ return hintNode(hint.node(), k); },
+                            std::forward<Types>(args)...).first;
        }
 
+	/**
+	 * \brief This function finds the first pair whose key is not smaller than the input key.
+	 * \param x Key to be searched, it does not need to be in the tree.
+	 * \return Iterator Iterator to the pair, or end() if all the keys are smaller than x.
+	 */
+	Iterator lower_bound(const Tk& x) { return iter(lowerNode(x)); }
+	Const_iterator lower_bound(const Tk& x) const { return citer(lowerNode(x)); }
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	Iterator lower_bound(const K& x) { return iter(lowerNode(x)); }
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	Const_iterator lower_bound(const K& x) const { return citer(lowerNode(x)); }
+
+	/**
+	 * \brief This function finds the first pair whose key is bigger than the input key.
+	 * \param x Key to be searched, it does not need to be in the tree.
+	 * \return Iterator Iterator to the pair, or end() if no key is bigger than x.
+	 */
+	Iterator upper_bound(const Tk& x) { return iter(upperNode(x)); }
+	Const_iterator upper_bound(const Tk& x) const { return citer(upperNode(x)); }
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	Iterator upper_bound(const K& x) { return iter(upperNode(x)); }
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	Const_iterator upper_bound(const K& x) const { return citer(upperNode(x)); }
+
+	/**
+	 * \brief This function finds the pairs whose key is equivalent to the input key.
+	 * \param x Key to be searched.
+	 * \return std::pair<Iterator,Iterator> lower_bound(x) and upper_bound(x): since the keys are unique,
+	 * the range contains the pair with key x, if any, and is empty otherwise.
+	 */
+	std::pair<Iterator, Iterator> equal_range(const Tk& x);
+	std::pair<Const_iterator, Const_iterator> equal_range(const Tk& x) const;
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	std::pair<Iterator, Iterator> equal_range(const K& x)
+	{
+	  auto n = equalNodes(x);
+	  return std::make_pair(iter(n.first), iter(n.second));
+	}
+	template<class K, class C = Tc, class = typename C::is_transparent>
+	std::pair<Const_iterator, Const_iterator> equal_range(const K& x) const
+	{
+	  auto n = equalNodes(x);
+	  return std::make_pair(citer(n.first), citer(n.second));
+	}
+
+	/**
+	 * \brief This function returns a view of the pairs whose key is in [lo, hi).
+	 * \param lo Smallest key of the range.
+	 * \param hi First key after the range.
+	 * \return range_view<Iterator> View which can be visited with a range-based for loop.
+	 *
+	 * Only the two bounds are searched, in O(h): the pairs are then reached by the iterators while the view is visited,
+	 * so visiting k pairs costs O(h+k) and nothing is copied. The view is empty if hi is not bigger than lo.
+	 */
+	range_view<Iterator> range(const Tk& lo, const Tk& hi);
+	range_view<Const_iterator> range(const Tk& lo, const Tk& hi) const;
+
 	/**
  	 * \brief This function finds a key of a node inside the BST.
          * \param x It needs as argument a key.
@@ -282,12 +1087,107 @@ public:
          */
         Const_iterator find(const Tk& x) const;
 
+        /**
+         * \brief This function finds a key equivalent to a value of another type, without building a Tk.
+         * \param x Value comparable with the keys by Tc.
+         * \return Iterator Iterator to the pair with that key, or end() if there is no such pair.
+         *
+         * The overloads of find, count, contains, erase and of the bound queries taking such values are available only
+         * if Tc is transparent (it defines is_transparent), e.g. std::less<>: a tree with std::string keys can then be
+         * searched with a const char* or a string_view, without allocating a temporary std::string.
+         */
+        template<class K, class C = Tc, class = typename C::is_transparent>
+        Iterator find(const K& x) { return iter(findKey(x)); }
+        template<class K, class C = Tc, class = typename C::is_transparent>
+        Const_iterator find(const K& x) const { return citer(findKey(x)); }
+
+        /**
+         * \brief This function counts the pairs with a key, 0 or 1 since the keys are unique.
+         * \param x Key to be searched.
+         */
+        std::size_t count(const Tk& x) const { return findKey(x) != nullptr; }
+        template<class K, class C = Tc, class = typename C::is_transparent>
+        std::size_t count(const K& x) const { return findKey(x) != nullptr; }
+
+        /**
+         * \brief This function tells if a key is in the tree.
+         * \param x Key to be searched.
+         */
+        bool contains(const Tk& x) const { return findKey(x) != nullptr; }
+        template<class K, class C = Tc, class = typename C::is_transparent>
+        bool contains(const K& x) const { return findKey(x) != nullptr; }
+
+        /**
+         * \brief This function finds a batch of keys.
+         * \param keys Keys to be found.
+         * \return std::vector<Iterator> For every key, in the same order, an iterator to the node with that key,
+         * or end() if the key is not in the tree.
+         *
+         * The batch is sorted once, then the keys are searched in increasing order: every search starts from
+         * the node where the previous one ended and only climbs up to the first ancestor which may contain the key,
+         * so the upper levels of the tree, which are shared by most paths, are visited only once.
+         */
+        std::vector<Iterator> find_many(const std::vector<Tk>& keys);
+
+        /**
+         * \brief This function finds a batch of keys.
+         * \param keys Keys to be found.
+         * \return std::vector<Const_iterator> For every key, in the same order, a constant iterator to the node
+         * with that key, or cend() if the key is not in the tree.
+         */
+        std::vector<Const_iterator> find_many(const std::vector<Tk>& keys) const;
+
+        /**
+         * \brief This function finds a group of keys, advancing several searches in lockstep.
+         * \param keys Pointer to the first key to be found.
+         * \param count Number of keys.
+         * \param width Number of searches in flight at the same time.
+         * \return std::vector<Iterator> For every key, in the same order, an iterator to the node with that key,
+         * or end() if the key is not in the tree.
+         *
+         * Every search descends one level at a time, in turn with the others, and the next node of each search
+         * is prefetched before switching to the following search. In this way the cache misses of independent
+         * searches overlap, which pays off when the tree is much bigger than the caches. When a search ends,
+         * its slot is given to the next key of the group.
+         */
+        std::vector<Iterator> find_group(const Tk* keys, const std::size_t count, const std::size_t width = 8);
+
+        /**
+         * \brief This function finds a group of keys, advancing several searches in lockstep.
+         * \param keys Keys to be found.
+         * \param width Number of searches in flight at the same time.
+         * \return std::vector<Iterator> For every key, in the same order, an iterator to the node with that key,
+         * or end() if the key is not in the tree.
+         */
+        std::vector<Iterator> find_group(const std::vector<Tk>& keys, const std::size_t width = 8)
+        { return find_group(keys.data(), keys.size(), width); }
+
+        /**
+         * \brief This function inserts a batch of pairs key-value.
+         * \param values Pairs to be inserted.
+         * \return std::vector<std::pair<Iterator,bool>> For every pair, in the same order, the result that insert would give.
+         *
+         * The pairs are inserted in increasing key order, every search starting from the previously inserted node.
+         * If the batch contains the same key more than once, the first pair is inserted.
+         */
+        std::vector<std::pair<Iterator, bool>> insert_many(const std::vector<std::pair<Tk,Tv>>& values);
+
+        /**
+         * \brief This function erases a batch of keys.
+         * \param keys Keys to be erased.
+         * \return std::size_t Number of nodes erased.
+         *
+         * All the nodes are found with a single sorted walk (as in find_many) before being erased.
+         * Keys which are not in the tree are ignored.
+         */
+        std::size_t erase_many(const std::vector<Tk>& keys);
+
 	/**
          * \brief Overload of the subscript operator [].
          * \param k Node key to be accessed.
          * \return Tv& Node value associated with k.
          *
-         * It is a find-or-add operator. It tries to find an element with the input key inside the tree. If it exists, it returns a reference to the associated value. If it doesn't, it creates and inserts a new node containing the input key and a default constructed value, and returns a reference to the value as well.
+         * It is a find-or-add operator. It tries to find an element with the input key inside the tree. If it exists, it returns a reference to the associated value. If it doesn't, it creates and inserts a new node containing the input key and a default constructed value, and returns a reference to the value as well. It calls try_emplace, so no value is built when the key is found.
          */
   	Tv& operator[] (const Tk& k);
 
@@ -298,16 +1198,238 @@ public:
          */
 	Tv& operator[] (Tk&& k);
 
+	/**
+	 * \brief Function that replaces the content of the tree with a range of key-value pairs.
+	 * \param first Beginning of the range.
+	 * \param last End of the range.
+	 *
+	 * If the keys of the range are strictly increasing the perfectly balanced tree is built directly from
+	 * the range in O(n) time, without searching the position of the nodes from the root. Otherwise
+	 * the pairs are copied in a buffer and sorted first, and only the first pair with a given key is kept,
+	 * as if they were inserted one by one.
+	 */
+	template<class It>
+	void assign(It first, It last)
+	{
+	  clear();
+	  assignRange(first, last, typename std::iterator_traits<It>::iterator_category{});
+	}
+
 	/**
 	 * \brief Function balancing the tree.
+	 *
+	 * The nodes are relinked in place (Day-Stout-Warren algorithm): the tree is first
+	 * turned into a vine and then compressed into a balanced tree, in O(n) time and O(1)
+	 * extra memory. No node is allocated or copied, so iterators and addresses stay valid.
 	 */
 	void Balance();
 
+	/**
+	 * \brief Function balancing the tree with several threads.
+	 * \param threads Number of threads, 1 for the sequential Balance.
+	 *
+	 * The nodes are collected in order (the subtrees below the top levels by parallel tasks) and relinked
+	 * as a balanced tree: the two halves of every sequence of nodes are disjoint subtrees, so the halves bigger than
+	 * task_cutoff are relinked by tasks of a work-stealing pool. Like Balance, no node is allocated or copied.
+	 * It costs O(n) extra memory for the sequence of the nodes.
+	 */
+	void Balance(std::size_t threads);
+
+	/**
+	 * \brief Function that applies a function to every pair of the tree with several threads.
+	 * \param f Function called as f(pair&), it must be safe to call it from several threads on different pairs.
+	 * \param threads Number of threads, by default the number of cores.
+	 *
+	 * The tree is split in subtrees (about eight per thread if the tree is balanced), which are visited in order
+	 * by the tasks of a work-stealing pool: the pairs of a subtree are visited in order, but different subtrees
+	 * are visited at the same time. The keys cannot be modified.
+	 */
+	template<class F>
+	void parallel_for_each(F f, std::size_t threads = std::thread::hardware_concurrency());
+
+	/**
+	 * \brief Function that applies a function to every pair of the tree with several threads.
+	 * \param f Function called as f(const pair&).
+	 * \param threads Number of threads, by default the number of cores.
+	 */
+	template<class F>
+	void parallel_for_each(F f, std::size_t threads = std::thread::hardware_concurrency()) const;
+
+	/**
+	 * \brief Function that reduces the pairs of the tree with several threads, in ascending key order.
+	 * \param init Initial value.
+	 * \param reduce Associative operation, called as reduce(T, T).
+	 * \param transform Function turning a pair in a T, called as transform(const pair&).
+	 * \param threads Number of threads, by default the number of cores.
+	 * \return T reduce(...reduce(reduce(init, transform(p1)), transform(p2))..., transform(pn)), with the pairs in ascending order
+	 * and the operations grouped by subtrees.
+	 *
+	 * Every subtree is reduced by a task, then the partial results are merged in order by the calling thread,
+	 * so the operation needs to be associative but not commutative (e.g. concatenation).
+	 */
+	template<class T, class R, class M>
+	T parallel_reduce(T init, R reduce, M transform, std::size_t threads = std::thread::hardware_concurrency()) const;
+
+	/**
+	 * \brief Function that counts the pairs satisfying a predicate with several threads.
+	 * \param pred Predicate, called as pred(const pair&).
+	 * \param threads Number of threads, by default the number of cores.
+	 * \return std::size_t Number of pairs for which pred is true.
+	 */
+	template<class P>
+	std::size_t parallel_count_if(P pred, std::size_t threads = std::thread::hardware_concurrency()) const;
+
+	/**
+	 * \brief Function that returns the number of pairs in the tree.
+	 *
+	 * It is O(1) with the order_statistics policy, O(n) otherwise.
+	 */
+	std::size_t size() const noexcept { return countNodes(sized{}); }
+
+	/**
+	 * \brief Function that returns the pair with the k-th smallest key.
+	 * \param k Position of the pair in ascending key order, from 0.
+	 * \return Iterator Iterator to the pair, or end() if k >= size().
+	 *
+	 * It needs the order_statistics policy: the search goes down the tree comparing k with the sizes
+	 * of the left subtrees, so it costs O(h).
+	 */
+	Iterator select(std::size_t k) { return iter(selectNode(k)); }
+	Const_iterator select(std::size_t k) const { return citer(selectNode(k)); }
+
+	/**
+	 * \brief Function that returns the number of keys smaller than the input key.
+	 * \param x Key, which does not need to be in the tree.
+	 *
+	 * It needs the order_statistics policy and costs O(h).
+	 */
+	std::size_t rank(const Tk& x) const;
+
+	/**
+	 * \brief Function that returns the number of keys in the range [lo, hi).
+	 * \param lo Smallest key of the range.
+	 * \param hi First key after the range.
+	 *
+	 * It needs the order_statistics policy and costs two calls to rank.
+	 */
+	std::size_t count_range(const Tk& lo, const Tk& hi) const
+	{ return comp(lo, hi) ? rank(hi) - rank(lo) : 0; }
+
+	/**
+	 * \brief Function that moves an iterator by several positions.
+	 * \param it Iterator of the tree, possibly end().
+	 * \param n Number of positions, negative to move backwards.
+	 * \return Iterator Iterator n positions after it, or end() if the position is outside the tree.
+	 *
+	 * It needs the order_statistics policy: the position of it is computed climbing to the root, and the new one with select,
+	 * so it costs O(h) instead of the O(n) of n increments.
+	 */
+	Iterator advance(Iterator it, std::ptrdiff_t n) { return iter(selectNode(position(it.node()) + n)); }
+	Const_iterator advance(Const_iterator it, std::ptrdiff_t n) const { return citer(selectNode(position(it.node()) + n)); }
+
+	/**
+	 * \brief Function that takes an immutable snapshot of the tree.
+	 * \return FrozenBST<Tk,Tv,Tc> Snapshot with the keys in Eytzinger order, built with one in-order visit of the tree.
+	 */
+	FrozenBST<Tk,Tv,Tc> freeze() const;
+
+	/**
+	 * \brief Function that saves a snapshot of the tree in a binary file.
+	 * \param path Name of the file.
+	 *
+	 * The file can be mapped in memory with FrozenBST<Tk,Tv,Tc>::open, see FrozenBST::save.
+	 */
+	void save(const std::string& path) const;
+
+	/**
+	 * \brief Function that writes the pairs of the tree in ascending key order, as chunks of binary data.
+	 * \tparam W Writer, callable as writer(const char* data, std::size_t size), for example ostream_writer.
+	 * \tparam KC Codec of the keys, by default delta_codec for integers and codec otherwise (see codec.h).
+	 * \tparam VC Codec of the values.
+	 * \param writer Object receiving the bytes.
+	 * \param chunk Number of bytes after which a chunk is completed and sent to the writer.
+	 * std::length_error is thrown if a chunk exceeds max_chunk_size (codec.h), which can only happen with a huge chunk or pair.
+	 *
+	 * The stream begins with "BSTS" and the version of the format; every chunk is made of the number of pairs,
+	 * the number of bytes and the encoded pairs, and the codecs are reset at its beginning. A chunk with no pairs ends the stream.
+	 */
+	template<class W, class KC = typename key_codec<Tk>::type, class VC = codec<Tv>>
+	void serialize(W&& writer, std::size_t chunk = 1<<16, KC kc = KC{}, VC vc = VC{}) const;
+
+	/**
+	 * \brief Function that replaces the content of the tree with the pairs written by serialize.
+	 * \tparam R Reader, callable as reader(char* data, std::size_t size), returning the number of bytes read, for example istream_reader.
+	 * \param reader Object providing the bytes.
+	 *
+	 * The pairs arrive in ascending order, so the tree is built balanced in linear time, as the range constructor does.
+	 * An exception is thrown if the stream is malformed, and in that case the tree is left unchanged. The size of a chunk is
+	 * checked against max_chunk_size before the chunk is read, so a corrupted stream cannot make it allocate a huge buffer.
+	 */
+	template<class R, class KC = typename key_codec<Tk>::type, class VC = codec<Tv>>
+	void deserialize(R&& reader, KC kc = KC{}, VC vc = VC{});
+
 	/*
 	 * \brief Function wich erase the node containing the input key, if any.
 	 * \param k Key to be deleted.
 	 */
         void erase(const Tk& k);
+        template<class K, class C = Tc, class = typename C::is_transparent>
+        void erase(const K& k) { eraseKey(k); }
+
+	/**
+	 * \brief Function that unlinks the node with a key from the tree and gives it to the caller.
+	 * \param k Key of the node.
+	 * \return node_type Handle owning the node, empty if the key is not in the tree.
+	 *
+	 * The node is neither copied nor deleted, only the iterators to it are invalidated. Node handles need the nodes
+	 * to be allocated with new, so they are not available with node_pool.
+	 */
+	node_type extract(const Tk& k);
+
+	/**
+	 * \brief Function that unlinks the node pointed by an iterator from the tree and gives it to the caller.
+	 * \param pos Iterator to a node of the tree, not end().
+	 */
+	node_type extract(Iterator pos) noexcept;
+
+	/**
+	 * \brief This function links in the tree a node extracted from a tree of the same type.
+	 * \param nh Handle owning the node, it is emptied if the node is linked.
+	 * \return insert_return_type The position of the node with its key, and the handle if the key was already in the tree.
+	 *
+	 * The position is searched as in insert, but nothing is allocated or copied.
+	 */
+	insert_return_type insert(node_type&& nh);
+
+	/**
+	 * \brief Function that moves into the tree the nodes of another tree whose keys are not in the tree.
+	 * \param other Tree of the same type, it keeps the nodes with the keys already present.
+	 *
+	 * The nodes of other are visited in order and relinked, never copied: every search starts from the node
+	 * linked before (as in insert_many), so merging m sorted nodes does not cost m full searches.
+	 */
+	void merge(BST& other);
+
+	/**
+	 * \brief Function that splits the tree at a key.
+	 * \param k Key where the tree is split, it does not need to be in the tree.
+	 * \return BST Tree with the nodes whose key is not smaller than k, the other nodes stay in the tree.
+	 *
+	 * The path of the search of k is cut into pieces, which are joined back into the two trees from the bottom.
+	 * Every join costs the difference of the heights of its trees, so the whole split costs O(h), O(log n) in a red-black tree.
+	 * No node is copied and the sizes and the links kept by the policies stay valid.
+	 */
+	BST split(const Tk& k);
+
+	/**
+	 * \brief Function that appends the nodes of another tree, whose keys are all bigger than the keys of the tree.
+	 * \param other Tree to be appended, it is left empty.
+	 *
+	 * The smallest node of other is unlinked and becomes the joining node, so the cost is O(log n) in a
+	 * red-black tree. An exception std::invalid_argument is thrown if the keys are not in order, and in that
+	 * case the two trees are left unchanged.
+	 */
+	void join(BST&& other);
 
         #ifdef PRINT
 	/**
@@ -346,7 +1468,7 @@ public:
        /**
         *\brief Destructor for the binary search tree.
         */
-       ~BST() noexcept = default;
+       ~BST() noexcept { clear(); }
 };
 
 #include"methods.h"
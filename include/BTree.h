@@ -0,0 +1,995 @@
+/**
+ * \file BTree.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief Class implementing a cache-conscious B+ tree with the same interface of the class BST.
+ */
+
+#ifndef __BTREE_
+#define __BTREE_
+
+#include<memory>
+#include<utility> //pair
+#include<iostream>
+#include<iterator>
+#include<vector>
+#include<algorithm>
+#include<new> //placement new
+
+#include"simd.h"
+
+/**
+ * \brief Function that computes how many elements of a given size fit in a given number of bytes,
+ * clamped between 8 and 64.
+ * \param size Size of an element.
+ * \param bytes Number of bytes.
+ */
+constexpr std::size_t btree_capacity(const std::size_t size, const std::size_t bytes)
+{ return bytes/size < 8 ? 8 : (bytes/size > 64 ? 64 : bytes/size); }
+
+/**
+ * \brief Iterator of the class BTree.
+ * \tparam L Type of the leaves.
+ * \tparam I Type of the pointed data, const for constant iterators.
+ *
+ * The iterator points to a position of a leaf, leaves are linked in ascending key order.
+ */
+template<class L, class I>
+class btree_iterator
+{
+  template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C> friend class BTree;
+
+  /** Leaf containing the current element */
+  L* leaf = nullptr;
+  /** Position of the current element in the leaf */
+  std::size_t pos = 0;
+
+public:
+
+  using value_type = I;
+  using reference  = value_type&;
+  using pointer = value_type*;
+  using iterator_category = std::forward_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+
+  /**
+   * \brief Default contructor for the class btree_iterator.
+   */
+  btree_iterator() = default;
+
+  /**
+   * \brief Custom constructor for the class btree_iterator.
+   * \param l Leaf.
+   * \param p Position in the leaf.
+   */
+  btree_iterator(L* l, const std::size_t p) noexcept : leaf{l}, pos{p} {}
+
+  /**
+   * \brief Conversion from a non constant iterator.
+   */
+  template<class J>
+  btree_iterator(const btree_iterator<L,J>& it) noexcept : leaf{it.leaf}, pos{it.pos} {}
+
+  /**
+   * \brief Overload of the pre-increment operator ++.
+   * \return btree_iterator& Incremented iterator.
+   */
+  btree_iterator& operator++() noexcept
+  {
+    if(++pos == leaf->count)
+    {
+      leaf = leaf->next;
+      pos = 0;
+    }
+    return *this;
+  }
+
+  /**
+   * \brief Overload of the post-increment operator ++.
+   * \return btree_iterator Iterator before advancing to the next element.
+   */
+  btree_iterator operator++(int) noexcept
+  { btree_iterator tmp {*this};
+    ++(*this);
+    return tmp;
+  }
+
+  /**
+   * \brief Overload of the operator ==.
+   * \return bool True if and only if the input iterators point to the same element.
+   */
+  friend bool operator==(const btree_iterator& x, const btree_iterator& y)
+  { return x.leaf==y.leaf && x.pos==y.pos; }
+
+  /**
+   * \brief Overload of the operator !=.
+   * \return bool True if and only if input iterators point to different elements.
+   */
+  friend bool operator!=(const btree_iterator& x, const btree_iterator& y)
+  { return !(x==y); }
+
+  /**
+   * \brief Overload of the dereference operator *.
+   * \return reference Pair key-value the iterator is pointing to.
+   */
+  reference operator*() const noexcept
+  { return leaf->data()[pos]; }
+
+  /**
+   * \brief Overload of the arrow operator ->.
+   * \return pointer Pair key-value the iterator is pointing to.
+   */
+  pointer operator->() const noexcept
+  { return &(*(*this)); }
+
+  template<class M, class J> friend class btree_iterator;
+};
+
+/**
+ * \brief B+ tree storing many keys per node.
+ * \tparam Tk Type of node keys, it must be default constructible.
+ * \tparam Tv Type of node values.
+ * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ * \tparam B Maximum number of keys of an inner node. Default is the number of keys fitting in 256 bytes (4 cache lines).
+ * \tparam C Maximum number of pairs of a leaf. Default is the number of pairs fitting in 512 bytes.
+ *
+ * Inner nodes only store the keys which separate their children, in a contiguous array, so that
+ * a search touches a few cache lines per level, and the height of the tree is log_B(n).
+ * The pairs key-value are stored in the leaves, which are linked in ascending order for the iteration.
+ * The public interface is the one of the class BST, so that the two containers can be swapped with a typedef.
+ * Unlike BST, insert and erase move the pairs inside the leaves, so they invalidate the iterators.
+ */
+template<class Tk, class Tv, class Tc=std::less<Tk>,
+         std::size_t B=btree_capacity(sizeof(Tk), 256),
+         std::size_t C=btree_capacity(sizeof(std::pair<const Tk,Tv>), 512)>
+class BTree
+{
+public:
+
+  using pair = std::pair<const Tk,Tv>;
+
+private:
+
+  /** Common part of the nodes */
+  struct base
+  {
+    /** Number of keys (inner nodes) or pairs (leaves) */
+    std::size_t count = 0;
+    /** True if the node is a leaf */
+    bool isleaf;
+    explicit base(const bool l) noexcept : isleaf{l} {}
+  };
+
+  /** Leaf: sorted array of pairs */
+  struct leaf_node : base
+  {
+    /** Next leaf in ascending key order */
+    leaf_node* next = nullptr;
+    /** Storage of the pairs, constructed only in the positions [0, count) */
+    alignas(pair) unsigned char storage[C*sizeof(pair)];
+    leaf_node() noexcept : base{true} {}
+    ~leaf_node() { for(std::size_t i=0; i<this->count; ++i) data()[i].~pair(); }
+    pair* data() noexcept { return reinterpret_cast<pair*>(storage); }
+  };
+
+  /** Inner node: sorted array of separating keys and the children */
+  struct inner_node : base
+  {
+    /** child[i] contains the keys in [keys[i-1], keys[i]) */
+    Tk keys[B];
+    base* child[B+1];
+    inner_node() noexcept : base{false} {}
+  };
+
+public:
+
+  using Iterator = btree_iterator<leaf_node, pair>;
+  using Const_iterator = btree_iterator<leaf_node, const pair>;
+
+private:
+
+  /** Root of the tree */
+  base* root = nullptr;
+  /** Number of pairs in the tree */
+  std::size_t elements = 0;
+
+  /** Minimum number of pairs of a leaf which is not the root */
+  static constexpr std::size_t min_leaf = C/2;
+  /** Minimum number of keys of an inner node which is not the root */
+  static constexpr std::size_t min_inner = B/2;
+
+  /**
+   * \brief Function which moves a pair to uninitialized memory, destroying the source.
+   */
+  static void relocate(pair* to, pair* from)
+  {
+    ::new(static_cast<void*>(to)) pair(std::move(*from));
+    from->~pair();
+  }
+
+  /**
+   * \brief Function that returns the position of the first pair of a leaf whose key is not smaller than x.
+   */
+  std::size_t lowerPos(leaf_node* l, const Tk& x) const
+  { return lowerPos(l, x, has_simd_search<Tk,Tc>{}); }
+
+  /**
+   * \brief Overloads of lowerPos: the scan stops at the first key not smaller than x, or, for arithmetic keys
+   * sorted by std::less, all the keys smaller than x are counted, without branches depending on the keys.
+   */
+  std::size_t lowerPos(leaf_node* l, const Tk& x, std::false_type) const
+  {
+    pair* d = l->data();
+    std::size_t i = 0;
+    while(i < l->count && comp(d[i].first, x)) ++i;
+    return i;
+  }
+  std::size_t lowerPos(leaf_node* l, const Tk& x, std::true_type) const noexcept
+  {
+    pair* d = l->data();
+    std::size_t i = 0;
+    for(std::size_t j=0; j<l->count; ++j)
+      i += d[j].first < x;
+    return i;
+  }
+
+  /**
+   * \brief Function that returns the index of the child of an inner node which may contain x.
+   */
+  std::size_t childPos(inner_node* n, const Tk& x) const
+  { return childPos(n, x, has_simd_search<Tk,Tc>{}); }
+
+  /**
+   * \brief Overloads of childPos: the keys are scanned one at a time, or compared with vector instructions
+   * if they are arithmetic and sorted by std::less.
+   */
+  std::size_t childPos(inner_node* n, const Tk& x, std::false_type) const
+  {
+    std::size_t i = 0;
+    while(i < n->count && !comp(x, n->keys[i])) ++i;
+    return i;
+  }
+  std::size_t childPos(inner_node* n, const Tk& x, std::true_type) const noexcept
+  { return simd_count(n->keys, n->count, x); }
+
+  /**
+   * \brief Function that returns the leaf which may contain x.
+   */
+  leaf_node* findLeaf(const Tk& x) const
+  {
+    base* n = root;
+    if(!n) return nullptr;
+    while(!n->isleaf)
+    {
+      inner_node* in = static_cast<inner_node*>(n);
+      n = in->child[childPos(in, x)];
+    }
+    return static_cast<leaf_node*>(n);
+  }
+
+  /** Result of the insertion in a subtree */
+  struct split
+  {
+    /** New right sibling of the subtree, if it has been split */
+    base* right = nullptr;
+    /** Smallest key of the new right sibling */
+    Tk key{};
+  };
+
+  /** Nodes allocated before a leaf is split, so that the splits never fail halfway */
+  struct spares
+  {
+    /** New right sibling of the leaf */
+    leaf_node* leaf = nullptr;
+    /** New inner nodes, chained through child[0] */
+    inner_node* inner = nullptr;
+    inner_node* take() noexcept
+    {
+      inner_node* in = inner;
+      inner = static_cast<inner_node*>(in->child[0]);
+      return in;
+    }
+    ~spares() { delete leaf; while(inner) delete take(); }
+  };
+
+  /**
+   * \brief Recursive function which inserts a pair in a subtree.
+   * \param n Root of the subtree.
+   * \param x Pair to be inserted.
+   * \param result Position of the pair with the key of x, and true if it has been inserted.
+   * \param sp Nodes allocated for the splits.
+   * \param full Number of inner nodes needed above n if n is split: the full ancestors which are split
+   * as well, plus the new root if they reach the root.
+   * \return split The new right sibling if the subtree has been split.
+   *
+   * A full leaf allocates all the nodes of the splits before it is touched, and its split is undone
+   * if the new pair cannot be constructed, so that a failed insertion leaves the tree unchanged.
+   * This requires that moving the keys does not throw, and neither does copying them, since the pairs
+   * are moved between the positions of the leaves and their keys are const.
+   */
+  template<class T>
+  split insertRec(base* n, T&& x, std::pair<Iterator,bool>& result, spares& sp, std::size_t full);
+
+  /**
+   * \brief Recursive function which erases a key from a subtree.
+   * \param n Root of the subtree.
+   * \param x Key to be erased.
+   * \return bool True if the key has been erased.
+   *
+   * Children left with too few elements borrow from a sibling or are merged with it.
+   */
+  bool eraseRec(base* n, const Tk& x);
+
+  /**
+   * \brief Function which restores the minimum number of elements of a child of an inner node.
+   * \param p Inner node.
+   * \param i Position of the child.
+   */
+  void fixChild(inner_node* p, std::size_t i);
+
+  /**
+   * \brief Recursive function which deletes a subtree.
+   */
+  static void destroy(base* n) noexcept;
+
+  /**
+   * \brief Function which replaces the content of the tree with a range which is known to be strictly sorted.
+   * \param first Beginning of the range.
+   * \param count Number of pairs in the range.
+   *
+   * The leaves are filled evenly from left to right and the inner levels are built bottom up, in O(n).
+   */
+  template<class It>
+  void assignSorted(It first, std::size_t count);
+
+  /**
+   * \brief Functions which replace the content of the tree with a range, dispatched on the iterator category.
+   */
+  template<class It>
+  void assignRange(It first, It last, std::input_iterator_tag);
+  template<class It>
+  void assignRange(It first, It last, std::forward_iterator_tag);
+
+public:
+
+  /**comparison operator */
+  Tc comp;
+
+  /**
+   * \brief Default constructor for the class BTree.
+   */
+  BTree() = default;
+
+  /**
+   * \brief Custom custroctor.
+   *
+   * Constructs a tree given its first pair.
+   */
+  BTree(pair newRoot, Tc cmp=Tc{})
+  : comp{cmp}
+  { insert(std::move(newRoot)); }
+
+  /**
+   * \brief Range constructor, see assign.
+   */
+  template<class It, class = typename std::iterator_traits<It>::iterator_category>
+  BTree(It first, It last, Tc cmp=Tc{})
+  : comp{cmp}
+  { assign(first, last); }
+
+  /**
+   * \brief Copy constructor.
+   *
+   * The pairs of the input tree are already sorted, so the copy is built bottom up in O(n).
+   */
+  BTree(const BTree& tree)
+  : comp{tree.comp}
+  { assignSorted(tree.begin(), tree.size()); }
+
+  /**
+   * \brief Copy assignment.
+   */
+  BTree& operator=(const BTree& tree)
+  {
+    if(this == &tree) return *this;
+    clear();
+    comp = tree.comp;
+    assignSorted(tree.begin(), tree.size());
+    return *this;
+  }
+
+  /**
+   * \brief Move constructor.
+   */
+  BTree(BTree&& tree) noexcept
+  : root{tree.root}, elements{tree.elements}, comp{std::move(tree.comp)}
+  { tree.root = nullptr; tree.elements = 0; }
+
+  /**
+   * \brief Move assignment.
+   */
+  BTree& operator=(BTree&& tree) noexcept
+  {
+    if(this == &tree) return *this;
+    clear();
+    root = tree.root;
+    elements = tree.elements;
+    comp = std::move(tree.comp);
+    tree.root = nullptr;
+    tree.elements = 0;
+    return *this;
+  }
+
+  /**
+   * \brief Function to clear the content of the tree.
+   */
+  void clear() noexcept
+  {
+    destroy(root);
+    root = nullptr;
+    elements = 0;
+  }
+
+  /**
+   * \brief Function that returns the number of pairs in the tree.
+   */
+  std::size_t size() const noexcept { return elements; }
+
+  /**
+   * \brief Function used to start iterations on the tree.
+   * \return Iterator An iterator pointing to the pair with the smallest key.
+   */
+  Iterator begin() noexcept { return Iterator{firstLeaf(), 0}; }
+
+  /**
+   * \brief Function used to finish an iteration on the tree.
+   * \return Iterator An iterator pointing to one past the last pair of the tree.
+   */
+  Iterator end() noexcept { return Iterator{nullptr, 0}; }
+
+  /**
+   * \brief Function used to start iterations on the tree.
+   */
+  Const_iterator begin() const noexcept { return Const_iterator{firstLeaf(), 0}; }
+
+  /**
+   * \brief Function used to finish an iteration on the tree.
+   */
+  Const_iterator end() const noexcept { return Const_iterator{nullptr, 0}; }
+
+  /**
+   * \brief Function used to start iterations on the tree.
+   */
+  Const_iterator cbegin() const noexcept { return begin(); }
+
+  /**
+   * \brief Function used to finish an iteration on the tree.
+   */
+  Const_iterator cend() const noexcept { return end(); }
+
+  /**
+   * \brief This function inserts a new pair in the tree.
+   * \param x Pair composed by a key and a value.
+   * \return std::pair<Iterator,bool> An iterator to the pair with the key of x and a bool
+   * which is true if the pair has been inserted, false if the key was already in the tree.
+   */
+  std::pair<Iterator, bool> insert(const pair& x) { return insertPrivate(x); }
+
+  /**
+   * \brief This function inserts a new pair in the tree.
+   * \param x Pair composed by a key and a value.
+   * \return std::pair<Iterator,bool> An iterator to the pair with the key of x and a bool
+   * which is true if the pair has been inserted, false if the key was already in the tree.
+   */
+  std::pair<Iterator, bool> insert(pair&& x) { return insertPrivate(std::move(x)); }
+
+  /**
+   * \brief This function inserts a new element into the container constructed in-place.
+   * \param args A key-value pair.
+   */
+  template<typename... Types>
+  std::pair<Iterator, bool> emplace(Types&&... args)
+  { return insert(pair(std::forward<Types>(args)...)); }
+
+  /**
+   * \brief This function finds a key in the tree.
+   * \param x Key to be found.
+   * \return Iterator An iterator to the pair with that key, end() if the key is not in the tree.
+   */
+  Iterator find(const Tk& x)
+  {
+    leaf_node* l = findLeaf(x);
+    if(!l) return end();
+    std::size_t i = lowerPos(l, x);
+    if(i < l->count && !comp(x, l->data()[i].first)) return Iterator{l, i};
+    return end();
+  }
+
+  /**
+   * \brief This function finds a key in the tree.
+   * \param x Key to be found.
+   * \return Const_iterator A constant iterator to the pair with that key, cend() if the key is not in the tree.
+   */
+  Const_iterator find(const Tk& x) const
+  { return const_cast<BTree*>(this)->find(x); }
+
+  /**
+   * \brief Overload of the subscript operator [].
+   * \param k Key to be accessed.
+   * \return Tv& Value associated with k, a default constructed value is inserted if k is not in the tree.
+   */
+  Tv& operator[] (const Tk& k)
+  {
+    Iterator it = find(k);
+    if(it != end()) return it->second;
+    return insert(pair{k, Tv{}}).first->second;
+  }
+
+  /**
+   * \brief Overload of the subscript operator [] for moves.
+   * \param k Key to be accessed.
+   * \return Tv& Value associated with k.
+   */
+  Tv& operator[] (Tk&& k)
+  {
+    Iterator it = find(k);
+    if(it != end()) return it->second;
+    return insert(pair{std::move(k), Tv{}}).first->second;
+  }
+
+  /**
+   * \brief Function that replaces the content of the tree with a range of key-value pairs.
+   *
+   * As for BST, unsorted ranges are sorted first and only the first pair with a given key is kept.
+   */
+  template<class It>
+  void assign(It first, It last)
+  {
+    clear();
+    assignRange(first, last, typename std::iterator_traits<It>::iterator_category{});
+  }
+
+  /**
+   * \brief Function balancing the tree: a B+ tree is always balanced, so it does nothing.
+   */
+  void Balance() noexcept {}
+
+  /**
+   * \brief Function which erases the pair with the input key, if any.
+   * \param k Key to be deleted.
+   */
+  void erase(const Tk& k);
+
+  /**
+   * \brief Functions that prints the pairs in acending order.
+   * \param os Stream to which the pairs are sent.
+   */
+  std::ostream& printOrderedList(std::ostream& os) const;
+
+  /**
+   * \brief Operator << to print the tree in ascending key order.
+   */
+  friend std::ostream& operator<<(std::ostream& os, const BTree& tree)
+  { return tree.printOrderedList(os); }
+
+  /**
+   *\brief Destructor for the class BTree.
+   */
+  ~BTree() noexcept { clear(); }
+
+private:
+
+  /**
+   * \brief Function that returns the leftmost leaf.
+   */
+  leaf_node* firstLeaf() const noexcept
+  {
+    base* n = root;
+    if(!n) return nullptr;
+    while(!n->isleaf) n = static_cast<inner_node*>(n)->child[0];
+    return static_cast<leaf_node*>(n);
+  }
+
+  /**
+   * \brief Private function which inserts a pair in the tree, splitting the root if needed.
+   */
+  template<class T>
+  std::pair<Iterator, bool> insertPrivate(T&& x);
+};
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+template<class T>
+std::pair<typename BTree<Tk,Tv,Tc,B,C>::Iterator, bool> BTree<Tk,Tv,Tc,B,C>::insertPrivate(T&& x)
+{
+  std::pair<Iterator, bool> result;
+  spares sp;
+  split s;
+  if(!root)
+  {
+    root = new leaf_node;
+    try
+    {
+      s = insertRec(root, std::forward<T>(x), result, sp, 1);
+    }
+    catch(...)
+    {
+      delete static_cast<leaf_node*>(root);
+      root = nullptr;
+      throw;
+    }
+  }
+  else
+    s = insertRec(root, std::forward<T>(x), result, sp, 1);
+  if(s.right)
+  { //the root has been split: the tree grows by one level
+    inner_node* r = sp.take();
+    r->keys[0] = std::move(s.key);
+    r->child[0] = root;
+    r->child[1] = s.right;
+    r->count = 1;
+    root = r;
+  }
+  if(result.second) ++elements;
+  return result;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+template<class T>
+typename BTree<Tk,Tv,Tc,B,C>::split BTree<Tk,Tv,Tc,B,C>::insertRec(base* n, T&& x, std::pair<Iterator,bool>& result,
+                                                                   spares& sp, std::size_t full)
+{
+  split s;
+  if(n->isleaf)
+  {
+    leaf_node* l = static_cast<leaf_node*>(n);
+    std::size_t i = lowerPos(l, x.first);
+    if(i < l->count && !comp(x.first, l->data()[i].first))
+    {
+      result = std::make_pair(Iterator{l, i}, false);
+      return s;
+    }
+    if(l->count == C)
+    { //split the leaf in two halves, the new pair goes in the proper one
+      std::size_t half = C/2;
+      sp.leaf = new leaf_node;
+      for(; full>0; --full)
+      {
+        inner_node* in = new inner_node;
+        in->child[0] = sp.inner;
+        sp.inner = in;
+      }
+      s.key = l->data()[half].first; //the first pair of the right half, whichever half gets the new one
+      leaf_node* r = sp.leaf;
+      sp.leaf = nullptr;
+      for(std::size_t j=half; j<C; ++j)
+        relocate(r->data()+j-half, l->data()+j);
+      r->count = C-half;
+      l->count = half;
+      r->next = l->next;
+      l->next = r;
+      s.right = r;
+      if(i > half)
+      {
+        l = r;
+        i -= half;
+      }
+    }
+    pair* d = l->data();
+    for(std::size_t j=l->count; j>i; --j) //make room for the new pair
+      relocate(d+j, d+j-1);
+    try
+    {
+      ::new(static_cast<void*>(d+i)) pair(std::forward<T>(x));
+    }
+    catch(...)
+    { //close the gap
+      for(std::size_t j=i; j<l->count; ++j)
+        relocate(d+j, d+j+1);
+      if(s.right)
+      { //undo the split, which the parent will never see: the pairs go back to the left leaf
+        leaf_node* left = static_cast<leaf_node*>(n);
+        leaf_node* r = static_cast<leaf_node*>(s.right);
+        for(std::size_t j=0; j<r->count; ++j)
+          relocate(left->data()+left->count+j, r->data()+j);
+        left->count += r->count;
+        r->count = 0;
+        left->next = r->next;
+        delete r;
+      }
+      throw;
+    }
+    ++l->count;
+    result = std::make_pair(Iterator{l, i}, true);
+    return s;
+  }
+  inner_node* in = static_cast<inner_node*>(n);
+  std::size_t i = childPos(in, x.first);
+  split c = insertRec(in->child[i], std::forward<T>(x), result, sp, in->count == B ? full+1 : 0);
+  if(!c.right) return s;
+  //the child has been split: its new sibling goes in position i+1
+  if(in->count == B)
+  { //split the inner node in place: with the new key there are B+1 keys and B+2 children, the middle key goes up
+    inner_node* r = sp.take();
+    std::size_t half = B/2;
+    //the upper half goes to r, key m of the sequence with the new key is keys[m] before i and keys[m-1] after it
+    for(std::size_t m=half+1; m<=B; ++m)
+      r->keys[m-half-1] = m < i ? std::move(in->keys[m]) : (m == i ? std::move(c.key) : std::move(in->keys[m-1]));
+    for(std::size_t m=half+1; m<=B+1; ++m)
+      r->child[m-half-1] = m <= i ? in->child[m] : (m == i+1 ? c.right : in->child[m-1]);
+    s.key = half < i ? std::move(in->keys[half]) : (half == i ? std::move(c.key) : std::move(in->keys[half-1]));
+    if(i < half)
+    { //the new key and child belong to the lower half
+      for(std::size_t j=half-1; j>i; --j)
+        in->keys[j] = std::move(in->keys[j-1]);
+      in->keys[i] = std::move(c.key);
+      for(std::size_t j=half; j>i+1; --j)
+        in->child[j] = in->child[j-1];
+      in->child[i+1] = c.right;
+    }
+    in->count = half;
+    r->count = B-half;
+    s.right = r;
+    return s;
+  }
+  for(std::size_t j=in->count; j>i; --j)
+  {
+    in->keys[j] = std::move(in->keys[j-1]);
+    in->child[j+1] = in->child[j];
+  }
+  in->keys[i] = std::move(c.key);
+  in->child[i+1] = c.right;
+  ++in->count;
+  return s;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+void BTree<Tk,Tv,Tc,B,C>::erase(const Tk& k)
+{
+  if(!root) {std::cout<<"Empty tree"<<std::endl; return;}
+  if(!eraseRec(root, k)) {std::cout<<"key is not in the tree"<<std::endl; return;}
+  --elements;
+  if(root->count == 0)
+  { //the root is left without keys: the tree shrinks by one level
+    if(root->isleaf)
+    {
+      delete static_cast<leaf_node*>(root);
+      root = nullptr;
+    }
+    else
+    {
+      inner_node* old = static_cast<inner_node*>(root);
+      root = old->child[0];
+      delete old;
+    }
+  }
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+bool BTree<Tk,Tv,Tc,B,C>::eraseRec(base* n, const Tk& x)
+{
+  if(n->isleaf)
+  {
+    leaf_node* l = static_cast<leaf_node*>(n);
+    std::size_t i = lowerPos(l, x);
+    if(i == l->count || comp(x, l->data()[i].first)) return false;
+    pair* d = l->data();
+    d[i].~pair();
+    for(std::size_t j=i+1; j<l->count; ++j)
+      relocate(d+j-1, d+j);
+    --l->count;
+    return true;
+  }
+  inner_node* in = static_cast<inner_node*>(n);
+  std::size_t i = childPos(in, x);
+  if(!eraseRec(in->child[i], x)) return false;
+  fixChild(in, i);
+  return true;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+void BTree<Tk,Tv,Tc,B,C>::fixChild(inner_node* p, std::size_t i)
+{
+  base* c = p->child[i];
+  if(c->isleaf)
+  {
+    leaf_node* l = static_cast<leaf_node*>(c);
+    if(l->count >= min_leaf) return;
+    leaf_node* left = i > 0 ? static_cast<leaf_node*>(p->child[i-1]) : nullptr;
+    leaf_node* right = i < p->count ? static_cast<leaf_node*>(p->child[i+1]) : nullptr;
+    if(left && left->count > min_leaf)
+    { //borrow the last pair of the left sibling
+      for(std::size_t j=l->count; j>0; --j)
+        relocate(l->data()+j, l->data()+j-1);
+      relocate(l->data(), left->data()+left->count-1);
+      --left->count;
+      ++l->count;
+      p->keys[i-1] = l->data()[0].first;
+    }
+    else if(right && right->count > min_leaf)
+    { //borrow the first pair of the right sibling
+      relocate(l->data()+l->count, right->data());
+      ++l->count;
+      for(std::size_t j=1; j<right->count; ++j)
+        relocate(right->data()+j-1, right->data()+j);
+      --right->count;
+      p->keys[i] = right->data()[0].first;
+    }
+    else
+    { //merge with a sibling: the right one of the pair is deleted
+      if(!left) { left = l; l = right; ++i; }
+      for(std::size_t j=0; j<l->count; ++j)
+        relocate(left->data()+left->count+j, l->data()+j);
+      left->count += l->count;
+      l->count = 0;
+      left->next = l->next;
+      delete l;
+      for(std::size_t j=i; j<p->count; ++j)
+      {
+        p->keys[j-1] = std::move(p->keys[j]);
+        p->child[j] = p->child[j+1];
+      }
+      --p->count;
+    }
+    return;
+  }
+  inner_node* n = static_cast<inner_node*>(c);
+  if(n->count >= min_inner) return;
+  inner_node* left = i > 0 ? static_cast<inner_node*>(p->child[i-1]) : nullptr;
+  inner_node* right = i < p->count ? static_cast<inner_node*>(p->child[i+1]) : nullptr;
+  if(left && left->count > min_inner)
+  { //rotate a key from the left sibling through the parent
+    for(std::size_t j=n->count; j>0; --j)
+    {
+      n->keys[j] = std::move(n->keys[j-1]);
+      n->child[j+1] = n->child[j];
+    }
+    n->child[1] = n->child[0];
+    n->keys[0] = std::move(p->keys[i-1]);
+    n->child[0] = left->child[left->count];
+    p->keys[i-1] = std::move(left->keys[left->count-1]);
+    --left->count;
+    ++n->count;
+  }
+  else if(right && right->count > min_inner)
+  { //rotate a key from the right sibling through the parent
+    n->keys[n->count] = std::move(p->keys[i]);
+    n->child[n->count+1] = right->child[0];
+    ++n->count;
+    p->keys[i] = std::move(right->keys[0]);
+    for(std::size_t j=1; j<right->count; ++j)
+      right->keys[j-1] = std::move(right->keys[j]);
+    for(std::size_t j=1; j<=right->count; ++j)
+      right->child[j-1] = right->child[j];
+    --right->count;
+  }
+  else
+  { //merge with a sibling, the separating key comes down from the parent
+    if(!left) { left = n; n = right; ++i; }
+    left->keys[left->count] = std::move(p->keys[i-1]);
+    for(std::size_t j=0; j<n->count; ++j)
+      left->keys[left->count+1+j] = std::move(n->keys[j]);
+    for(std::size_t j=0; j<=n->count; ++j)
+      left->child[left->count+1+j] = n->child[j];
+    left->count += n->count+1;
+    delete n;
+    for(std::size_t j=i; j<p->count; ++j)
+    {
+      p->keys[j-1] = std::move(p->keys[j]);
+      p->child[j] = p->child[j+1];
+    }
+    --p->count;
+  }
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+void BTree<Tk,Tv,Tc,B,C>::destroy(base* n) noexcept
+{
+  if(!n) return;
+  if(n->isleaf)
+  {
+    delete static_cast<leaf_node*>(n);
+    return;
+  }
+  inner_node* in = static_cast<inner_node*>(n);
+  for(std::size_t i=0; i<=in->count; ++i) //the height is logarithmic, so recursion is safe
+    destroy(in->child[i]);
+  delete in;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+template<class It>
+void BTree<Tk,Tv,Tc,B,C>::assignSorted(It first, std::size_t count)
+{
+  if(count == 0) return;
+  //leaves: the pairs are spread evenly, so that no leaf has less than min_leaf pairs
+  std::size_t nodes = (count+C-1)/C;
+  std::vector<base*> level;
+  std::vector<Tk> lows; //smallest key of every node of the level
+  level.reserve(nodes);
+  lows.reserve(nodes);
+  leaf_node* previous = nullptr;
+  for(std::size_t k=0; k<nodes; ++k)
+  {
+    leaf_node* l = new leaf_node;
+    if(previous) previous->next = l;
+    previous = l;
+    level.push_back(l);
+    std::size_t n = count/nodes + (k < count%nodes);
+    for(std::size_t j=0; j<n; ++j, ++first)
+    {
+      ::new(static_cast<void*>(l->data()+j)) pair(*first);
+      ++l->count;
+      ++elements;
+    }
+    lows.push_back(l->data()[0].first);
+  }
+  //inner levels, built bottom up
+  while(level.size() > 1)
+  {
+    nodes = (level.size()+B)/(B+1);
+    std::vector<base*> upper;
+    std::vector<Tk> upperLows;
+    std::size_t next = 0;
+    for(std::size_t k=0; k<nodes; ++k)
+    {
+      inner_node* in = new inner_node;
+      std::size_t n = level.size()/nodes + (k < level.size()%nodes); //number of children
+      in->child[0] = level[next];
+      upperLows.push_back(std::move(lows[next]));
+      for(std::size_t j=1; j<n; ++j)
+      {
+        in->keys[j-1] = std::move(lows[next+j]);
+        in->child[j] = level[next+j];
+      }
+      in->count = n-1;
+      next += n;
+      upper.push_back(in);
+    }
+    level = std::move(upper);
+    lows = std::move(upperLows);
+  }
+  root = level[0];
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+template<class It>
+void BTree<Tk,Tv,Tc,B,C>::assignRange(It first, It last, std::input_iterator_tag)
+{
+  std::vector<std::pair<Tk,Tv>> values(first, last); //buffer of the pairs
+  auto less = [this](const std::pair<Tk,Tv>& a, const std::pair<Tk,Tv>& b) { return comp(a.first, b.first); };
+  std::stable_sort(values.begin(), values.end(), less);
+  //keep the first pair of every group with the same key
+  auto unique = std::unique(values.begin(), values.end(),
+                            [&less](const std::pair<Tk,Tv>& a, const std::pair<Tk,Tv>& b) { return !less(a, b); });
+  values.erase(unique, values.end());
+  assignSorted(std::make_move_iterator(values.begin()), values.size());
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+template<class It>
+void BTree<Tk,Tv,Tc,B,C>::assignRange(It first, It last, std::forward_iterator_tag)
+{
+  using value = typename std::iterator_traits<It>::value_type;
+  It unsorted = std::adjacent_find(first, last,
+                                   [this](const value& a, const value& b) { return !comp(a.first, b.first); });
+  if(unsorted != last)
+    assignRange(first, last, std::input_iterator_tag{});
+  else
+    assignSorted(first, std::distance(first, last));
+}
+
+template<class Tk, class Tv, class Tc, std::size_t B, std::size_t C>
+std::ostream& BTree<Tk,Tv,Tc,B,C>::printOrderedList(std::ostream& os) const
+{
+  Const_iterator start{cbegin()};
+  Const_iterator stop{cend()};
+  if (start == stop)
+   return os << "Empty tree"<<std::endl;
+  while(start!=stop)
+  {
+    os<<(*start).first<<":"<<(*start).second<<"    ";
+    ++start;
+  }
+  return os;
+}
+
+#endif
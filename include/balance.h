@@ -0,0 +1,89 @@
+/**
+ * \file balance.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the balancing policies of the class BST.
+ */
+
+#ifndef __BALANCE_
+#define __BALANCE_
+
+#include<cstddef> //size_t
+#include<type_traits>
+
+#include"node.h"
+
+/**
+ * \brief Policy for a plain binary search tree.
+ *
+ * Nodes are linked where the search ends and the tree is never restructured,
+ * the only way to balance it is to call BST::Balance().
+ */
+struct unbalanced
+{
+  /** Extra data stored in every node: nothing. */
+  using meta = no_meta;
+};
+
+/**
+ * \brief Policy for a red-black tree.
+ *
+ * insert() and erase() restore the red-black invariants after every
+ * modification, so that the height of the tree never exceeds 2log2(n+1)
+ * and find, insert and erase are logarithmic in the worst case.
+ */
+struct red_black
+{
+  /** Extra data stored in every node: its colour. */
+  struct meta
+  {
+    /** True if the node is red, false if it is black. */
+    bool red = true;
+  };
+};
+
+/**
+ * \brief Policy adding the size of its subtree to every node of a tree balanced by another policy.
+ * \tparam P Balancing policy, unbalanced or red_black.
+ *
+ * The sizes are kept up to date by insert, erase, the rotations and Balance, so that BST::size is O(1)
+ * and BST::select, BST::rank and BST::count_range cost one descent of the tree. Every node
+ * stores a std::size_t more than with P.
+ */
+template<class P>
+struct order_statistics : P
+{
+  /** Extra data stored in every node: the one of P and the number of nodes of its subtree. */
+  struct meta : P::meta
+  {
+    std::size_t size = 1;
+  };
+};
+
+/**
+ * \brief Policy linking every node to the previous and the next one in key order, in a tree balanced by another policy.
+ * \tparam P Balancing policy, possibly order_statistics.
+ *
+ * The links are kept up to date by insert and erase (rotations and Balance do not change the order of the nodes),
+ * so that the iterators move to the next node with a single pointer, in O(1) time in the worst case.
+ * Every node stores two pointers more than with P.
+ */
+template<class P>
+struct threaded : P
+{
+  /** Extra data stored in every node: the one of P and the links to its neighbours. */
+  struct meta : P::meta, thread_links {};
+};
+
+/**
+ * \brief Trait telling if a policy stores the size of the subtrees.
+ */
+template<class P>
+struct has_size : std::false_type {};
+
+template<class P>
+struct has_size<order_statistics<P>> : std::true_type {};
+
+template<class P>
+struct has_size<threaded<P>> : has_size<P> {};
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * \file codec.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the codecs used by BST::serialize and BST::deserialize.
+ */
+
+#ifndef __CODEC_
+#define __CODEC_
+
+#include<string>
+#include<cstring> //memcpy
+#include<cstdint>
+#include<iostream>
+#include<stdexcept> //runtime_error
+#include<type_traits>
+
+/**
+ * \brief Function that appends an unsigned integer to a buffer, 7 bits per byte (varint).
+ *
+ * The most significant bit of every byte tells if another byte follows, so small numbers take one byte.
+ */
+inline void put_varint(std::string& out, std::uint64_t x)
+{
+  char bytes[10];
+  std::size_t n = 0;
+  while(x >= 0x80)
+  {
+    bytes[n++] = static_cast<char>(x | 0x80);
+    x >>= 7;
+  }
+  bytes[n++] = static_cast<char>(x);
+  out.append(bytes, n);
+}
+
+/**
+ * \brief Function that reads an unsigned integer written by put_varint.
+ * \param in Position of the first byte, it is moved after the last one.
+ * \param end End of the buffer, an exception is thrown if it is reached before the last byte.
+ */
+inline std::uint64_t get_varint(const char*& in, const char* end)
+{
+  std::uint64_t x = 0;
+  for(unsigned shift=0; shift<64; shift+=7)
+  {
+    if(in == end) throw std::runtime_error{"deserialize: truncated varint"};
+    unsigned char b = static_cast<unsigned char>(*in++);
+    x |= std::uint64_t(b & 0x7f) << shift;
+    if(!(b & 0x80)) return x;
+  }
+  throw std::runtime_error{"deserialize: malformed varint"};
+}
+
+/**
+ * \brief Function that reads an unsigned integer written by put_varint from a reader.
+ * \param reader Reader of BST::deserialize, callable as reader(char* data, std::size_t size).
+ *
+ * The bytes are read one at a time, up to the last one of the varint, and decoded by get_varint.
+ */
+template<class R>
+std::uint64_t read_varint(R& reader)
+{
+  char bytes[10];
+  std::size_t n = 0;
+  do
+  {
+    if(reader(bytes+n, 1) != 1) throw std::runtime_error{"deserialize: truncated stream"};
+  }
+  while((bytes[n++] & 0x80) && n < sizeof(bytes));
+  const char* in = bytes;
+  return get_varint(in, bytes+n);
+}
+
+/**
+ * \brief Biggest chunk, in bytes, written by BST::serialize and accepted by BST::deserialize.
+ *
+ * A chunk is completed as soon as it reaches the size requested to serialize (64 KiB by default), so it exceeds
+ * that size by less than one pair: the limit leaves room for big pairs, while a corrupted size read by deserialize
+ * cannot make it allocate more than this.
+ */
+constexpr std::size_t max_chunk_size = std::size_t(1)<<24;
+
+/**
+ * \brief Codec writing the bytes of a trivially copyable object as they are in memory.
+ *
+ * A codec is an object with the member functions
+ * - void reset(), called at the beginning of every chunk, so that chunks are decoded independently;
+ * - void encode(std::string& out, const T& x), which appends x to out;
+ * - T decode(const char*& in, const char* end), which reads an object and moves in after it.
+ */
+template<class T, class = void>
+struct codec
+{
+  static_assert(std::is_trivially_copyable<T>::value, "no codec for this type: it is not trivially copyable");
+
+  void reset() noexcept {}
+
+  void encode(std::string& out, const T& x)
+  { out.append(reinterpret_cast<const char*>(&x), sizeof(T)); }
+
+  T decode(const char*& in, const char* end)
+  {
+    if(std::size_t(end-in) < sizeof(T)) throw std::runtime_error{"deserialize: truncated value"};
+    T x;
+    std::memcpy(&x, in, sizeof(T));
+    in += sizeof(T);
+    return x;
+  }
+};
+
+/**
+ * \brief Codec for integers: varint of the zig-zag encoding, so that small negative numbers take few bytes too.
+ */
+template<class T>
+struct codec<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T,bool>::value>::type>
+{
+  using U = typename std::make_unsigned<T>::type;
+
+  void reset() noexcept {}
+
+  void encode(std::string& out, const T& x)
+  {
+    std::uint64_t u = static_cast<U>(x);
+    if(std::is_signed<T>::value) //the sign goes in the lowest bit
+    {
+      std::int64_t s = x;
+      u = (std::uint64_t(s) << 1) ^ (s < 0 ? ~std::uint64_t(0) : 0);
+    }
+    put_varint(out, u);
+  }
+
+  T decode(const char*& in, const char* end)
+  {
+    std::uint64_t u = get_varint(in, end);
+    if(std::is_signed<T>::value)
+      u = (u >> 1) ^ (~(u & 1) + 1);
+    return static_cast<T>(static_cast<U>(u));
+  }
+};
+
+/**
+ * \brief Codec for strings: varint of the length followed by the characters.
+ */
+template<>
+struct codec<std::string>
+{
+  void reset() noexcept {}
+
+  void encode(std::string& out, const std::string& x)
+  {
+    put_varint(out, x.size());
+    out.append(x);
+  }
+
+  std::string decode(const char*& in, const char* end)
+  {
+    std::uint64_t n = get_varint(in, end);
+    if(std::uint64_t(end-in) < n) throw std::runtime_error{"deserialize: truncated string"};
+    std::string x{in, std::size_t(n)};
+    in += n;
+    return x;
+  }
+};
+
+/**
+ * \brief Codec for sorted integer keys: every key is written as the (zig-zag, varint) difference from the previous one.
+ *
+ * The differences are computed modulo 2^bits, so any order of the keys is allowed, but for close increasing keys
+ * they take one or two bytes.
+ */
+template<class T>
+struct delta_codec
+{
+  using U = typename std::make_unsigned<T>::type;
+  using S = typename std::make_signed<T>::type;
+
+  /** Previous key of the chunk */
+  U previous = 0;
+
+  void reset() noexcept { previous = 0; }
+
+  void encode(std::string& out, const T& x)
+  {
+    U d = static_cast<U>(static_cast<U>(x) - previous);
+    previous = static_cast<U>(x);
+    codec<S>{}.encode(out, static_cast<S>(d));
+  }
+
+  T decode(const char*& in, const char* end)
+  {
+    U d = static_cast<U>(codec<S>{}.decode(in, end));
+    previous = static_cast<U>(previous + d);
+    return static_cast<T>(previous);
+  }
+};
+
+/**
+ * \brief Trait selecting the default codec of the keys: delta_codec for integers, codec otherwise.
+ */
+template<class T, class = void>
+struct key_codec { using type = codec<T>; };
+
+template<class T>
+struct key_codec<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T,bool>::value>::type>
+{ using type = delta_codec<T>; };
+
+/**
+ * \brief Writer sending the chunks of BST::serialize to a std::ostream.
+ */
+struct ostream_writer
+{
+  std::ostream& os;
+
+  void operator()(const char* data, std::size_t size)
+  {
+    os.write(data, size);
+    if(!os) throw std::runtime_error{"serialize: the stream cannot be written"};
+  }
+};
+
+/**
+ * \brief Reader of BST::deserialize taking the bytes from a std::istream.
+ *
+ * A reader fills a buffer with up to size bytes and returns how many it has read, less than size only at the end of the input.
+ */
+struct istream_reader
+{
+  std::istream& is;
+
+  std::size_t operator()(char* data, std::size_t size)
+  {
+    is.read(data, size);
+    return is.gcount();
+  }
+};
+
+#endif
@@ -0,0 +1,329 @@
+/**
+ * \file concurrent.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief Class implementing a binary search tree which can be used by many threads at the same time.
+ */
+
+#ifndef __CONCURRENT_
+#define __CONCURRENT_
+
+#include<atomic>
+#include<mutex> //lock_guard
+#include<utility> //pair
+#include<iostream>
+#include<vector>
+#include<functional> //less
+
+#include"epoch.h"
+
+/**
+ * \brief Binary search tree shared by many threads, with lock-free reads and fine-grained locking of the writers.
+ * \tparam Tk Type of node keys.
+ * \tparam Tv Type of node values.
+ * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ *
+ * Readers go down the tree without taking any lock. Writers search the position of the key in the same way, then lock
+ * only the parent and the node they modify (always from the top, so there are no deadlocks) and validate
+ * that they are still linked and unchanged, otherwise they search again.
+ * Keys never move between nodes: a node with two children is only marked as deleted by erase, and stays in the tree
+ * to route the searches until it loses a child; other nodes are unlinked by linking their only child to their parent.
+ * A reader which is visiting an unlinked node can still go on, since its children are not modified anymore,
+ * and unlinked nodes are freed by the epoch based reclamation of epoch.h, when no reader can see them.
+ * The tree is not rebalanced, since rotations would move nodes under the readers: keys should be inserted in random order.
+ */
+template<class Tk, class Tv, class Tc=std::less<Tk>>
+class ConcurrentBST
+{
+public:
+
+  using pair = std::pair<const Tk,Tv>;
+
+private:
+
+  /** Node of the tree: key and value never change after the node is linked */
+  struct cnode
+  {
+    const Tk key;
+    const Tv value;
+    std::atomic<cnode*> left;
+    std::atomic<cnode*> right;
+    /** The key has been erased, the node may still be used to route the searches */
+    std::atomic<bool> deleted{false};
+    /** The node has been unlinked from the tree */
+    std::atomic<bool> removed{false};
+    /** Lock taken by the writers modifying the node or its children */
+    spinlock lock;
+
+    cnode(const pair& x, cnode* l=nullptr, cnode* r=nullptr)
+    : key{x.first}, value{x.second}, left{l}, right{r} {}
+  };
+
+  /** Root of the tree */
+  std::atomic<cnode*> root{nullptr};
+  /** Lock of the root pointer, taken instead of the lock of the parent when the node is the root */
+  spinlock rootLock;
+
+  static void deleteNode(void* n) { delete static_cast<cnode*>(n); }
+
+  /**
+   * \brief Function that searches a key without locks.
+   * \param x Key to be found.
+   * \param p Set to the parent of the last node visited, nullptr for the root.
+   * \param n Set to the node with key x, nullptr if it has not been found.
+   */
+  void search(const Tk& x, cnode*& p, cnode*& n) const
+  {
+    p = nullptr;
+    n = root.load(std::memory_order_acquire);
+    while(n)
+    {
+      if(comp(x, n->key))
+      {
+        p = n;
+        n = n->left.load(std::memory_order_acquire);
+      }
+      else if(comp(n->key, x))
+      {
+        p = n;
+        n = n->right.load(std::memory_order_acquire);
+      }
+      else
+        return;
+    }
+  }
+
+  /**
+   * \brief Function that returns the pointer of p which leads to key x (the root pointer if p is nullptr).
+   */
+  std::atomic<cnode*>& slot(cnode* p, const Tk& x) noexcept
+  { return !p ? root : (comp(x, p->key) ? p->left : p->right); }
+
+  /**
+   * \brief Function that returns the lock protecting the children of p (the root lock if p is nullptr).
+   */
+  spinlock& lockOf(cnode* p) noexcept { return p ? p->lock : rootLock; }
+
+  /**
+   * \brief Function that tells, with the lock of p, if p is still linked in the tree.
+   */
+  static bool linked(cnode* p) noexcept { return !p || !p->removed.load(std::memory_order_relaxed); }
+
+  /**
+   * \brief Function that unlinks a deleted node which has lost one of its children, if it is still in the tree.
+   * \param x Key of the node.
+   *
+   * Unlinking the node may leave its parent, if deleted, with a single child, so the parent is pruned too.
+   */
+  void prune(const Tk& x);
+
+public:
+
+  /**comparison operator */
+  Tc comp;
+
+  /**
+   * \brief Default constructor for the class ConcurrentBST.
+   */
+  ConcurrentBST() = default;
+
+  ConcurrentBST(const ConcurrentBST&) = delete;
+  ConcurrentBST& operator=(const ConcurrentBST&) = delete;
+
+  /**
+   * \brief This function inserts a new pair in the tree, it can be called by many threads.
+   * \param x Pair composed by a key and a value.
+   * \return bool True if the pair has been inserted, false if the key was already in the tree.
+   */
+  bool insert(const pair& x);
+
+  /**
+   * \brief This function erases a key from the tree, it can be called by many threads.
+   * \param x Key to be erased.
+   * \return bool True if the key has been erased, false if it was not in the tree.
+   */
+  bool erase(const Tk& x);
+
+  /**
+   * \brief This function finds a key without taking any lock, it can be called by many threads.
+   * \param x Key to be found.
+   * \param value Set to a copy of the value associated with x, if any.
+   * \return bool True if the key is in the tree.
+   */
+  bool find(const Tk& x, Tv& value) const
+  {
+    epoch_guard guard;
+    cnode* p;
+    cnode* n;
+    search(x, p, n);
+    if(!n || n->deleted.load(std::memory_order_acquire)) return false;
+    value = n->value;
+    return true;
+  }
+
+  /**
+   * \brief This function tells if a key is in the tree, it can be called by many threads.
+   */
+  bool contains(const Tk& x) const
+  {
+    epoch_guard guard;
+    cnode* p;
+    cnode* n;
+    search(x, p, n);
+    return n && !n->deleted.load(std::memory_order_acquire);
+  }
+
+  /**
+   * \brief Function that deletes all the nodes, no other thread may be using the tree.
+   */
+  void clear() noexcept;
+
+  /**
+   * \brief Functions that prints the pairs in acending order.
+   *
+   * It can be called while other threads modify the tree, but then the pairs printed may not be a snapshot of the tree.
+   */
+  std::ostream& printOrderedList(std::ostream& os) const;
+
+  /**
+   * \brief Operator << to print the tree in ascending key order.
+   */
+  friend std::ostream& operator<<(std::ostream& os, const ConcurrentBST& tree)
+  { return tree.printOrderedList(os); }
+
+  /**
+   *\brief Destructor for the class ConcurrentBST, no other thread may be using the tree.
+   */
+  ~ConcurrentBST() noexcept { clear(); }
+};
+
+template<class Tk, class Tv, class Tc>
+bool ConcurrentBST<Tk,Tv,Tc>::insert(const pair& x)
+{
+  epoch_guard guard;
+  for(;;)
+  {
+    cnode* p;
+    cnode* n;
+    search(x.first, p, n);
+    if(n && !n->deleted.load(std::memory_order_acquire)) return false;
+    std::lock_guard<spinlock> parentLock{lockOf(p)};
+    std::atomic<cnode*>& s = slot(p, x.first);
+    if(!n)
+    { //link a new leaf, if the position is still free
+      if(!linked(p) || s.load(std::memory_order_relaxed)) continue;
+      s.store(new cnode{x}, std::memory_order_release);
+      return true;
+    }
+    //the key is in a deleted node: the node is replaced by a new one, with the same children
+    std::lock_guard<spinlock> nodeLock{n->lock};
+    if(!linked(p) || s.load(std::memory_order_relaxed) != n || n->removed.load(std::memory_order_relaxed) ||
+       !n->deleted.load(std::memory_order_relaxed))
+      continue;
+    s.store(new cnode{x, n->left.load(std::memory_order_relaxed), n->right.load(std::memory_order_relaxed)},
+            std::memory_order_release);
+    n->removed.store(true, std::memory_order_release);
+    epoch_domain::instance().retire(n, deleteNode);
+    return true;
+  }
+}
+
+template<class Tk, class Tv, class Tc>
+bool ConcurrentBST<Tk,Tv,Tc>::erase(const Tk& x)
+{
+  epoch_guard guard;
+  cnode* p;
+  for(;;)
+  {
+    cnode* n;
+    search(x, p, n);
+    if(!n || n->deleted.load(std::memory_order_acquire)) return false;
+    std::lock_guard<spinlock> parentLock{lockOf(p)};
+    std::lock_guard<spinlock> nodeLock{n->lock};
+    std::atomic<cnode*>& s = slot(p, x);
+    if(!linked(p) || s.load(std::memory_order_relaxed) != n || n->removed.load(std::memory_order_relaxed))
+      continue;
+    if(n->deleted.load(std::memory_order_relaxed)) return false; //erased by another thread
+    n->deleted.store(true, std::memory_order_release);
+    cnode* l = n->left.load(std::memory_order_relaxed);
+    cnode* r = n->right.load(std::memory_order_relaxed);
+    if(l && r) return true; //the node stays, to route the searches
+    s.store(l ? l : r, std::memory_order_release);
+    n->removed.store(true, std::memory_order_release);
+    epoch_domain::instance().retire(n, deleteNode);
+    break;
+  }
+  if(p && p->deleted.load(std::memory_order_acquire)) //the parent may have been left with a single child
+    prune(p->key);
+  return true;
+}
+
+template<class Tk, class Tv, class Tc>
+void ConcurrentBST<Tk,Tv,Tc>::prune(const Tk& x)
+{
+  epoch_guard guard;
+  cnode* p;
+  cnode* n;
+  search(x, p, n);
+  if(!n || !n->deleted.load(std::memory_order_acquire)) return;
+  {
+    std::lock_guard<spinlock> parentLock{lockOf(p)};
+    std::lock_guard<spinlock> nodeLock{n->lock};
+    std::atomic<cnode*>& s = slot(p, x);
+    if(!linked(p) || s.load(std::memory_order_relaxed) != n || n->removed.load(std::memory_order_relaxed) ||
+       !n->deleted.load(std::memory_order_relaxed))
+      return;
+    cnode* l = n->left.load(std::memory_order_relaxed);
+    cnode* r = n->right.load(std::memory_order_relaxed);
+    if(l && r) return;
+    s.store(l ? l : r, std::memory_order_release);
+    n->removed.store(true, std::memory_order_release);
+    epoch_domain::instance().retire(n, deleteNode);
+  }
+  if(p && p->deleted.load(std::memory_order_acquire))
+    prune(p->key);
+}
+
+template<class Tk, class Tv, class Tc>
+void ConcurrentBST<Tk,Tv,Tc>::clear() noexcept
+{
+  std::vector<cnode*> stack;
+  if(cnode* r = root.exchange(nullptr)) stack.push_back(r);
+  while(!stack.empty())
+  {
+    cnode* n = stack.back();
+    stack.pop_back();
+    if(cnode* l = n->left.load(std::memory_order_relaxed)) stack.push_back(l);
+    if(cnode* r = n->right.load(std::memory_order_relaxed)) stack.push_back(r);
+    delete n;
+  }
+}
+
+template<class Tk, class Tv, class Tc>
+std::ostream& ConcurrentBST<Tk,Tv,Tc>::printOrderedList(std::ostream& os) const
+{
+  epoch_guard guard;
+  std::vector<cnode*> stack;
+  cnode* n = root.load(std::memory_order_acquire);
+  bool empty = true;
+  while(n || !stack.empty())
+  {
+    while(n)
+    {
+      stack.push_back(n);
+      n = n->left.load(std::memory_order_acquire);
+    }
+    n = stack.back();
+    stack.pop_back();
+    if(!n->deleted.load(std::memory_order_acquire))
+    {
+      os << n->key << ":" << n->value << "    ";
+      empty = false;
+    }
+    n = n->right.load(std::memory_order_acquire);
+  }
+  if(empty)
+    os << "Empty tree" << std::endl;
+  return os;
+}
+
+#endif
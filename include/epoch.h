@@ -0,0 +1,233 @@
+/**
+ * \file epoch.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the epoch based reclamation of the nodes of ConcurrentBST, and its spinlock.
+ */
+
+#ifndef __EPOCH_
+#define __EPOCH_
+
+#include<atomic>
+#include<cstdint>
+#include<cstddef> //size_t
+#include<vector>
+#include<mutex>
+#include<thread> //yield
+#include<stdexcept> //runtime_error
+
+/**
+ * \brief Lock made of a single atomic flag, small enough to be stored in every node.
+ *
+ * A thread waiting for the lock spins for a while and then yields the processor to the owner.
+ */
+class spinlock
+{
+  std::atomic<bool> locked{false};
+
+public:
+
+  void lock() noexcept
+  {
+    for(unsigned spins=0; locked.exchange(true, std::memory_order_acquire); ++spins)
+      while(locked.load(std::memory_order_relaxed))
+        if(++spins > 64) std::this_thread::yield();
+  }
+
+  void unlock() noexcept { locked.store(false, std::memory_order_release); }
+};
+
+/**
+ * \brief Epoch based reclamation of the memory shared by several threads.
+ *
+ * A thread reading shared nodes announces the global epoch it has seen (enter) and withdraws the announcement when it is done (leave).
+ * An unlinked node cannot be freed at once, since a reader may still be visiting it: it is retired, tagged with the current epoch,
+ * and freed only when the global epoch is two steps ahead. The global epoch advances only when every reader
+ * has announced the current one, so when it is two steps ahead no reader can still see the node.
+ * There is a single domain, shared by all the trees, and every thread uses a slot of a fixed table.
+ */
+class epoch_domain
+{
+public:
+
+  /** Maximum number of threads using the domain at the same time */
+  static constexpr std::size_t max_threads = 256;
+
+private:
+
+  /** Announcement of a thread: 2*epoch+1 while it is reading, 0 otherwise */
+  struct alignas(64) slot
+  {
+    std::atomic<std::uint64_t> state{0};
+    std::atomic<bool> used{false};
+  };
+
+  /** Retired object */
+  struct retired
+  {
+    void* p;
+    void (*destroy)(void*);
+    std::uint64_t epoch;
+  };
+
+  /** Per thread data: slot, nesting depth of the readers and objects retired by the thread */
+  struct thread_state
+  {
+    epoch_domain& domain;
+    std::size_t index;
+    unsigned depth = 0;
+    std::vector<retired> list;
+
+    explicit thread_state(epoch_domain& d) : domain{d}, index{d.acquireSlot()} {}
+    ~thread_state() { domain.releaseSlot(*this); }
+  };
+
+  slot slots[max_threads];
+  std::atomic<std::uint64_t> global{1};
+  /** Objects retired by threads which have terminated */
+  std::mutex orphanMutex;
+  std::vector<retired> orphans;
+
+  epoch_domain() = default;
+
+  std::size_t acquireSlot()
+  {
+    for(std::size_t i=0; i<max_threads; ++i)
+    {
+      bool expected = false;
+      if(!slots[i].used.load(std::memory_order_relaxed) && slots[i].used.compare_exchange_strong(expected, true))
+        return i;
+    }
+    throw std::runtime_error{"epoch_domain: too many threads"};
+  }
+
+  void releaseSlot(thread_state& t)
+  {
+    collect(t.list);
+    if(!t.list.empty())
+    {
+      std::lock_guard<std::mutex> lock{orphanMutex};
+      orphans.insert(orphans.end(), t.list.begin(), t.list.end());
+    }
+    slots[t.index].state.store(0, std::memory_order_release);
+    slots[t.index].used.store(false, std::memory_order_release);
+  }
+
+  thread_state& local()
+  {
+    static thread_local thread_state t{*this};
+    return t;
+  }
+
+  /**
+   * \brief Function that advances the global epoch, if all the readers have announced the current one.
+   */
+  void tryAdvance() noexcept
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t e = global.load();
+    for(auto& s: slots)
+    {
+      if(!s.used.load(std::memory_order_acquire)) continue;
+      std::uint64_t state = s.state.load(std::memory_order_acquire);
+      if((state & 1) && (state >> 1) != e) return;
+    }
+    global.compare_exchange_strong(e, e+1);
+  }
+
+  /**
+   * \brief Function that frees the objects of a list retired at least two epochs ago.
+   */
+  void collect(std::vector<retired>& list) noexcept
+  {
+    tryAdvance();
+    std::uint64_t e = global.load();
+    std::size_t kept = 0;
+    for(auto& r: list)
+    {
+      if(r.epoch + 2 <= e) r.destroy(r.p);
+      else list[kept++] = r;
+    }
+    list.resize(kept);
+  }
+
+public:
+
+  epoch_domain(const epoch_domain&) = delete;
+  epoch_domain& operator=(const epoch_domain&) = delete;
+
+  /**
+   * \brief Function that returns the domain.
+   */
+  static epoch_domain& instance()
+  {
+    static epoch_domain d;
+    return d;
+  }
+
+  /**
+   * \brief Function called by a thread before reading shared objects, calls can be nested.
+   *
+   * The first call of a thread takes a slot of the domain: std::runtime_error is thrown if all the max_threads slots
+   * are used by live threads, and the call can be retried when a thread has terminated.
+   */
+  void enter()
+  {
+    thread_state& t = local();
+    if(t.depth++) return;
+    slots[t.index].state.store(2*global.load(std::memory_order_acquire)+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst); //the announcement is visible before any read
+  }
+
+  /**
+   * \brief Function called by a thread after reading shared objects.
+   *
+   * It cannot throw, since the slot of the thread has been taken by enter.
+   */
+  void leave() noexcept
+  {
+    thread_state& t = local();
+    if(--t.depth) return;
+    slots[t.index].state.store(0, std::memory_order_release);
+  }
+
+  /**
+   * \brief Function that retires an object which has been unlinked, it will be destroyed when no reader can see it.
+   * \param p Object.
+   * \param destroy Function destroying the object.
+   */
+  void retire(void* p, void (*destroy)(void*))
+  {
+    thread_state& t = local();
+    t.list.push_back(retired{p, destroy, global.load()});
+    if(t.list.size() >= 64)
+    {
+      collect(t.list);
+      std::unique_lock<std::mutex> lock{orphanMutex, std::try_to_lock};
+      if(lock && !orphans.empty()) collect(orphans);
+    }
+  }
+
+  /**
+   * \brief Destructor: no thread is running, so all the retired objects can be destroyed.
+   */
+  ~epoch_domain()
+  {
+    for(auto& r: orphans)
+      r.destroy(r.p);
+  }
+};
+
+/**
+ * \brief Guard marking a scope in which the current thread reads shared nodes.
+ */
+class epoch_guard
+{
+public:
+  /** It throws if the thread cannot take a slot of the domain, see epoch_domain::enter. */
+  epoch_guard() { epoch_domain::instance().enter(); }
+  ~epoch_guard() { epoch_domain::instance().leave(); }
+  epoch_guard(const epoch_guard&) = delete;
+  epoch_guard& operator=(const epoch_guard&) = delete;
+};
+
+#endif
@@ -0,0 +1,508 @@
+/**
+ * \file frozen.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief Class implementing an immutable search tree stored in Eytzinger (breadth first) order.
+ */
+
+#ifndef __FROZEN_
+#define __FROZEN_
+
+#include<vector>
+#include<utility> //pair
+#include<iostream>
+#include<iterator>
+#include<cstdint> //uintptr_t
+#include<functional> //less
+#include<memory> //shared_ptr
+#include<string>
+#include<fstream>
+#include<cstdio> //rename
+#include<cstring> //memcpy
+#include<cstddef> //offsetof
+#include<stdexcept> //runtime_error
+#include<type_traits>
+
+#include<sys/mman.h> //mmap
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+/**
+ * \brief Header of the file written by FrozenBST::save.
+ *
+ * All the positions are offsets from the beginning of the file, so that the file can be mapped at any address.
+ */
+struct frozen_header
+{
+  /** "BSTFROZ" */
+  char magic[8];
+  /** Version of the format */
+  std::uint32_t version;
+  /** 0x01020304 written in the byte order of the machine that saved the file */
+  std::uint32_t endian;
+  std::uint64_t keySize, keyAlign, valueSize, valueAlign;
+  /** Number of pairs */
+  std::uint64_t count;
+  /** Offsets of the array of the keys and of the array of the values, both in Eytzinger order */
+  std::uint64_t keyOffset, valueOffset;
+  /** Size of the file */
+  std::uint64_t fileSize;
+  /** Checksum of the two arrays */
+  std::uint64_t checksum;
+  /** Checksum of the previous fields of the header */
+  std::uint64_t headerChecksum;
+};
+
+/**
+ * \brief Function computing a 64 bit checksum of a sequence of bytes, 8 bytes at a time.
+ * \param data Beginning of the bytes.
+ * \param size Number of bytes.
+ * \param h Checksum of the previous bytes, if the sequence is split.
+ */
+inline std::uint64_t frozen_checksum(const void* data, std::size_t size, std::uint64_t h = 0xcbf29ce484222325ull) noexcept
+{
+  const unsigned char* b = static_cast<const unsigned char*>(data);
+  std::size_t i = 0;
+  for(; i+8<=size; i+=8)
+  {
+    std::uint64_t w;
+    std::memcpy(&w, b+i, 8);
+    h = (h ^ w) * 0x100000001b3ull;
+    h ^= h >> 29;
+  }
+  for(; i<size; ++i)
+    h = (h ^ b[i]) * 0x100000001b3ull;
+  return h;
+}
+
+/**
+ * \brief Immutable snapshot of a search tree, whose keys and values are stored in two contiguous arrays.
+ * \tparam Tk Type of the keys, it must be default constructible.
+ * \tparam Tv Type of the values, it must be default constructible.
+ * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ *
+ * The keys are stored in the order of a breadth first visit of a complete binary search tree (Eytzinger layout):
+ * the children of the key in position k (counting from 1) are in positions 2k and 2k+1, so that the tree has no pointers,
+ * the first levels share a few cache lines and a search goes down with no branch depending on the keys.
+ * The value of the key in position k is in the same position of the array of the values.
+ */
+template<class Tk, class Tv, class Tc=std::less<Tk>>
+class FrozenBST
+{
+  /** Keys in Eytzinger order, owned by the snapshot (empty if the snapshot is mapped from a file) */
+  std::vector<Tk> keys;
+  /** Values, in the same order of the keys */
+  std::vector<Tv> values;
+  /** File mapped in memory, unmapped when the last copy of the snapshot is destroyed */
+  std::shared_ptr<const void> mapping;
+  /** Keys and values used by the searches, either in the vectors or in the mapped file: the key in position k is keyData[k-1] */
+  const Tk* keyData = nullptr;
+  const Tv* valueData = nullptr;
+  /** Number of pairs */
+  std::size_t count = 0;
+
+  /** Version of the format of the files */
+  static constexpr std::uint32_t version = 1;
+
+  /** Number of keys of a cache line: the search prefetches the descendants log2(line) levels below, which fill a line */
+  static constexpr std::size_t line = 64/sizeof(Tk) ? 64/sizeof(Tk) : 1;
+
+  /**
+   * \brief Function that returns the position of the first key in ascending order.
+   */
+  std::size_t first() const noexcept
+  {
+    std::size_t k = count ? 1 : 0;
+    while(k && 2*k <= count) k = 2*k;
+    return k;
+  }
+
+  /**
+   * \brief Function that returns the position of the key following the one in position k in ascending order, 0 if there is none.
+   */
+  std::size_t next(std::size_t k) const noexcept
+  {
+    if(2*k+1 <= count)
+    { //the smallest key of the right subtree
+      k = 2*k+1;
+      while(2*k <= count) k = 2*k;
+      return k;
+    }
+    while(k & 1) k >>= 1; //go up while k is a right child
+    return k >> 1;
+  }
+
+  /**
+   * \brief Function that returns the position of the first key not smaller than x, 0 if there is none.
+   *
+   * The search always goes down to the last level, choosing the child by adding the result of the comparison
+   * to the position. The bits of the final position record the path: the answer is the last node where the search went left,
+   * and it is found by removing the trailing ones and the following zero.
+   */
+  std::size_t lowerPos(const Tk& x) const
+  {
+    const std::size_t n = count;
+    const Tk* a = keyData;
+    std::size_t k = 1;
+    while(k <= n)
+    {
+      //prefetching is a hint, addresses past the end are never dereferenced
+      #if defined(__GNUC__)
+      __builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(a) + (line*k-1)*sizeof(Tk)));
+      #endif
+      k = 2*k + comp(a[k-1], x);
+    }
+    #if defined(__GNUC__)
+    return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+    #else
+    while(k & 1) k >>= 1; //remove the trailing ones
+    return k >> 1;
+    #endif
+  }
+
+  /**
+   * \brief Function that points the searches to the arrays of the snapshot, after copying or moving f.
+   */
+  void bind(const FrozenBST& f) noexcept
+  {
+    count = f.count;
+    if(mapping)
+    { //the arrays are in the shared mapping
+      keyData = f.keyData;
+      valueData = f.valueData;
+    }
+    else
+    {
+      keyData = keys.data();
+      valueData = values.data();
+    }
+  }
+
+  /**
+   * \brief Function that empties a snapshot whose content has been moved.
+   */
+  void unbind() noexcept
+  {
+    keyData = nullptr;
+    valueData = nullptr;
+    count = 0;
+  }
+
+public:
+
+  /**
+   * \brief Constant iterator of the class FrozenBST, it visits the keys in ascending order.
+   *
+   * Keys and values are stored in different arrays, so the iterator returns a pair of references built on the fly:
+   * it is an input iterator, since the result of the dereference is not a reference to a value_type stored in the snapshot.
+   */
+  class Const_iterator
+  {
+    friend class FrozenBST;
+
+    /** Snapshot which is visited */
+    const FrozenBST* tree = nullptr;
+    /** Position of the current key, 0 for the end */
+    std::size_t k = 0;
+
+    Const_iterator(const FrozenBST* t, const std::size_t pos) noexcept : tree{t}, k{pos} {}
+
+  public:
+
+    using value_type = std::pair<Tk, Tv>;
+    using reference = std::pair<const Tk&, const Tv&>;
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+
+    /** Result of the arrow operator, holding the pair of references */
+    struct pointer
+    {
+      reference p;
+      const reference* operator->() const noexcept { return &p; }
+    };
+
+    Const_iterator() = default;
+
+    /**
+     * \brief Overload of the pre-increment operator ++.
+     */
+    Const_iterator& operator++() noexcept
+    {
+      k = tree->next(k);
+      return *this;
+    }
+
+    /**
+     * \brief Overload of the post-increment operator ++.
+     */
+    Const_iterator operator++(int) noexcept
+    { Const_iterator tmp {*this};
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const Const_iterator& x, const Const_iterator& y) { return x.k == y.k; }
+    friend bool operator!=(const Const_iterator& x, const Const_iterator& y) { return !(x==y); }
+
+    /**
+     * \brief Overload of the dereference operator *.
+     * \return reference Pair of references to the current key and value.
+     */
+    reference operator*() const noexcept { return reference{tree->keyData[k-1], tree->valueData[k-1]}; }
+
+    /**
+     * \brief Overload of the arrow operator ->.
+     */
+    pointer operator->() const noexcept { return pointer{**this}; }
+  };
+
+  using Iterator = Const_iterator;
+
+  /**comparison operator */
+  Tc comp;
+
+  /**
+   * \brief Default constructor for the class FrozenBST, it creates an empty snapshot.
+   */
+  FrozenBST() = default;
+
+  /**
+   * \brief Constructor from a range of pairs key-value sorted in strictly increasing key order, like the elements of a BST.
+   * \param first Beginning of the range.
+   * \param last End of the range.
+   * \param cmp Comparison operator.
+   *
+   * The range is visited once: the pairs are appended to two buffers, which are then moved in Eytzinger order
+   * by an in-order visit of the implicit tree.
+   */
+  template<class It, class = typename std::iterator_traits<It>::iterator_category>
+  FrozenBST(It first, It last, Tc cmp=Tc{});
+
+  /**
+   * \brief Copy constructor, the copy of a mapped snapshot shares the mapping.
+   */
+  FrozenBST(const FrozenBST& f)
+  : keys{f.keys}, values{f.values}, mapping{f.mapping}, comp{f.comp}
+  { bind(f); }
+
+  /**
+   * \brief Move constructor.
+   */
+  FrozenBST(FrozenBST&& f) noexcept
+  : keys{std::move(f.keys)}, values{std::move(f.values)}, mapping{std::move(f.mapping)}, comp{std::move(f.comp)}
+  { bind(f); f.unbind(); }
+
+  /**
+   * \brief Copy assignment.
+   */
+  FrozenBST& operator=(const FrozenBST& f)
+  {
+    if(this != &f) *this = FrozenBST{f};
+    return *this;
+  }
+
+  /**
+   * \brief Move assignment.
+   */
+  FrozenBST& operator=(FrozenBST&& f) noexcept
+  {
+    if(this == &f) return *this;
+    keys = std::move(f.keys);
+    values = std::move(f.values);
+    mapping = std::move(f.mapping);
+    comp = std::move(f.comp);
+    bind(f);
+    f.unbind();
+    return *this;
+  }
+
+  /**
+   * \brief Function that writes the snapshot in a binary file, which can be mapped in memory by open.
+   * \param path Name of the file.
+   *
+   * The file contains a versioned header and the two arrays exactly as they are in memory, each aligned to 64 bytes,
+   * so the keys and the values must be trivially copyable. The file is written with a temporary name and then renamed,
+   * so that a file which is being read is never overwritten halfway. An exception is thrown if the file cannot be written.
+   */
+  void save(const std::string& path) const;
+
+  /**
+   * \brief Function that maps in memory a file written by save, as a read-only snapshot.
+   * \param path Name of the file.
+   * \param verify If true the checksum of the keys and of the values is checked, which reads the whole file.
+   * \param cmp Comparison operator, it must be the one the file was saved with.
+   * \return FrozenBST Snapshot using the keys and the values in the mapped file.
+   *
+   * Nothing is copied or deserialized: the pages of the file are read by the system when the searches touch them.
+   * The header (format, version, byte order, size and alignment of the types, offsets) is always checked, and an
+   * exception is thrown if it does not match.
+   */
+  static FrozenBST open(const std::string& path, bool verify=false, Tc cmp=Tc{});
+
+  /**
+   * \brief Function that returns the number of pairs of the snapshot.
+   */
+  std::size_t size() const noexcept { return count; }
+
+  /**
+   * \brief Function used to start iterations on the snapshot, in ascending key order.
+   */
+  Const_iterator begin() const noexcept { return Const_iterator{this, first()}; }
+
+  /**
+   * \brief Function used to finish iterations on the snapshot.
+   */
+  Const_iterator end() const noexcept { return Const_iterator{this, 0}; }
+
+  Const_iterator cbegin() const noexcept { return begin(); }
+  Const_iterator cend() const noexcept { return end(); }
+
+  /**
+   * \brief This function finds a key in the snapshot.
+   * \param x Key to be found.
+   * \return Const_iterator An iterator to the pair with that key, end() if the key is not in the snapshot.
+   */
+  Const_iterator find(const Tk& x) const
+  {
+    std::size_t k = lowerPos(x);
+    if(k && comp(x, keyData[k-1])) k = 0;
+    return Const_iterator{this, k};
+  }
+
+  /**
+   * \brief Function that returns the first pair whose key is not smaller than x.
+   * \param x Key to be searched.
+   * \return Const_iterator An iterator to that pair, end() if all the keys are smaller than x.
+   */
+  Const_iterator lower_bound(const Tk& x) const { return Const_iterator{this, lowerPos(x)}; }
+
+  /**
+   * \brief Functions that prints the pairs in acending order.
+   * \param os Stream to which the pairs are sent.
+   */
+  std::ostream& printOrderedList(std::ostream& os) const
+  {
+    if(!count)
+      return os << "Empty tree" << std::endl;
+    for(std::size_t k=first(); k; k=next(k))
+      os << keyData[k-1] << ":" << valueData[k-1] << "    ";
+    return os;
+  }
+
+  /**
+   * \brief Operator << to print the snapshot in ascending key order.
+   */
+  friend std::ostream& operator<<(std::ostream& os, const FrozenBST& tree)
+  { return tree.printOrderedList(os); }
+};
+
+template<class Tk, class Tv, class Tc>
+template<class It, class>
+FrozenBST<Tk,Tv,Tc>::FrozenBST(It first, It last, Tc cmp)
+: comp{cmp}
+{
+  std::vector<Tk> sortedKeys;
+  std::vector<Tv> sortedValues;
+  for(; first!=last; ++first)
+  {
+    sortedKeys.push_back((*first).first);
+    sortedValues.push_back((*first).second);
+  }
+  keys.resize(sortedKeys.size());
+  values.resize(sortedValues.size());
+  keyData = keys.data();
+  valueData = values.data();
+  count = keys.size();
+  std::size_t i = 0;
+  for(std::size_t k=this->first(); k; k=next(k), ++i) //the i-th key in ascending order goes in the i-th position of an in-order visit
+  {
+    keys[k-1] = std::move(sortedKeys[i]);
+    values[k-1] = std::move(sortedValues[i]);
+  }
+}
+
+template<class Tk, class Tv, class Tc>
+void FrozenBST<Tk,Tv,Tc>::save(const std::string& path) const
+{
+  static_assert(std::is_trivially_copyable<Tk>::value && std::is_trivially_copyable<Tv>::value,
+                "only trivially copyable keys and values can be saved");
+  auto align = [](std::uint64_t offset) { return (offset + 63) / 64 * 64; };
+  frozen_header h{};
+  std::memcpy(h.magic, "BSTFROZ", 8);
+  h.version = version;
+  h.endian = 0x01020304;
+  h.keySize = sizeof(Tk);
+  h.keyAlign = alignof(Tk);
+  h.valueSize = sizeof(Tv);
+  h.valueAlign = alignof(Tv);
+  h.count = count;
+  h.keyOffset = align(sizeof(frozen_header));
+  h.valueOffset = align(h.keyOffset + count*sizeof(Tk));
+  h.fileSize = h.valueOffset + count*sizeof(Tv);
+  h.checksum = frozen_checksum(valueData, count*sizeof(Tv), frozen_checksum(keyData, count*sizeof(Tk)));
+  h.headerChecksum = frozen_checksum(&h, offsetof(frozen_header, headerChecksum));
+
+  const std::string tmp = path + ".tmp";
+  std::ofstream file{tmp, std::ios::binary | std::ios::trunc};
+  const char zeros[64] = {};
+  file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  file.write(zeros, h.keyOffset - sizeof(h));
+  file.write(reinterpret_cast<const char*>(keyData), count*sizeof(Tk));
+  file.write(zeros, h.valueOffset - (h.keyOffset + count*sizeof(Tk)));
+  file.write(reinterpret_cast<const char*>(valueData), count*sizeof(Tv));
+  file.close();
+  if(!file || std::rename(tmp.c_str(), path.c_str()) != 0)
+  {
+    std::remove(tmp.c_str());
+    throw std::runtime_error{"FrozenBST::save: cannot write " + path};
+  }
+}
+
+template<class Tk, class Tv, class Tc>
+FrozenBST<Tk,Tv,Tc> FrozenBST<Tk,Tv,Tc>::open(const std::string& path, bool verify, Tc cmp)
+{
+  static_assert(std::is_trivially_copyable<Tk>::value && std::is_trivially_copyable<Tv>::value,
+                "only trivially copyable keys and values can be mapped");
+  auto fail = [&path](const std::string& why) { return std::runtime_error{"FrozenBST::open: " + path + ": " + why}; };
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) throw fail("cannot open the file");
+  struct stat st;
+  if(::fstat(fd, &st) != 0 || std::uint64_t(st.st_size) < sizeof(frozen_header))
+  {
+    ::close(fd);
+    throw fail("not a snapshot");
+  }
+  const std::size_t size = st.st_size;
+  void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); //the mapping stays valid
+  if(address == MAP_FAILED) throw fail("cannot map the file");
+  std::shared_ptr<const void> mapping{address, [size](const void* a) { ::munmap(const_cast<void*>(a), size); }};
+
+  frozen_header h;
+  std::memcpy(&h, address, sizeof(h));
+  if(std::memcmp(h.magic, "BSTFROZ", 8) != 0) throw fail("not a snapshot");
+  if(h.headerChecksum != frozen_checksum(&h, offsetof(frozen_header, headerChecksum))) throw fail("corrupted header");
+  if(h.version != version) throw fail("unsupported version " + std::to_string(h.version));
+  if(h.endian != 0x01020304) throw fail("saved with a different byte order");
+  if(h.keySize != sizeof(Tk) || h.keyAlign != alignof(Tk) || h.valueSize != sizeof(Tv) || h.valueAlign != alignof(Tv))
+    throw fail("saved with different key or value types");
+  //the arrays are bounded by dividing the free space, count*sizeof could overflow
+  if(h.fileSize != size || h.keyOffset % 64 || h.valueOffset % 64 ||
+     h.keyOffset > h.valueOffset || h.valueOffset > size ||
+     h.count > (h.valueOffset - h.keyOffset)/sizeof(Tk) || h.count > (size - h.valueOffset)/sizeof(Tv))
+    throw fail("truncated or corrupted file");
+
+  const unsigned char* base = static_cast<const unsigned char*>(address);
+  FrozenBST f;
+  f.comp = cmp;
+  f.mapping = std::move(mapping);
+  f.keyData = reinterpret_cast<const Tk*>(base + h.keyOffset);
+  f.valueData = reinterpret_cast<const Tv*>(base + h.valueOffset);
+  f.count = h.count;
+  if(verify &&
+     h.checksum != frozen_checksum(f.valueData, f.count*sizeof(Tv), frozen_checksum(f.keyData, f.count*sizeof(Tk))))
+    throw fail("wrong checksum");
+  return f;
+}
+
+#endif
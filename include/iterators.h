@@ -9,6 +9,8 @@
 
 #include<utility> //pair
 #include<memory>
+#include<iterator> //bidirectional_iterator_tag
+#include<type_traits> //enable_if
 
 #include"node.h"
 
@@ -17,10 +19,30 @@ class iterator
 {
 
   //BST has to use node()
-  template<class Tk, class Tv, class Tc> friend class BST;
+  template<class Tk, class Tv, class Tc, class Tb, class Ta> friend class BST;
+  //the constant iterator is built from the other one
+  template<class O, class J> friend class iterator;
 
   /** Raw pointer to a node of type N */
   N* current = nullptr;
+  /** Pointer to the node with the biggest key of the tree, as cached by the tree, used to decrement the end */
+  N* const* last = nullptr;
+
+  /**
+   * \brief Functions that return the node following n in key order.
+   *
+   * Threaded nodes know it, the others find it in the tree.
+   */
+  static N* successor(N* n, std::true_type) noexcept { return static_cast<N*>(n->next); }
+  static N* successor(N* n, std::false_type) noexcept
+  { return n->right ? n->right->findSmallest() : n->findBigger(); }
+
+  /**
+   * \brief Functions that return the node preceding n in key order.
+   */
+  static N* predecessor(N* n, std::true_type) noexcept { return static_cast<N*>(n->prev); }
+  static N* predecessor(N* n, std::false_type) noexcept
+  { return n->left ? n->left->findLargest() : n->findSmaller(); }
 
 public:
 
@@ -38,6 +60,22 @@ public:
 	 */
 	explicit iterator(N* n) noexcept : current{n} {};
 
+	/**
+	 * \brief Custom constructor for the class iterator.
+	 * \param n pointer to a node, nullptr for the end.
+	 * \param l pointer to the place where the tree keeps its biggest node.
+	 *
+	 * The iterators returned by the tree are built in this way, so that the end can be decremented.
+	 */
+	iterator(N* n, N* const* l) noexcept : current{n}, last{l} {}
+
+	/**
+	 * \brief Conversion from an iterator to a constant iterator.
+	 * \param i Iterator to the same node.
+	 */
+	template<class J, class = typename std::enable_if<std::is_same<const J, I>::value && !std::is_same<J, I>::value>::type>
+	iterator(const iterator<N,J>& i) noexcept : current{i.current}, last{i.last} {}
+
 	/**
 	 * \brief Destructor for the class iterator.
 	 */
@@ -46,7 +84,7 @@ public:
 	using value_type = I;
 	using reference  = value_type&;
 	using pointer = value_type*;
-	using iterator_category = std::forward_iterator_tag;
+	using iterator_category = std::bidirectional_iterator_tag;
 	using difference_type = std::ptrdiff_t;
 
        /**
@@ -54,6 +92,7 @@ public:
 	 * \return iterator& Incremented iterator.
 	 *
 	 * This operator is used to traverse the tree from leftmost node to the rightmost one.
+	 * With the threaded policy it follows the link to the next node.
 	 */
 	iterator& operator++();
 
@@ -67,6 +106,32 @@ public:
 	  return tmp;
 	}
 
+	/**
+	 * \brief Overload of the pre-decrement operator --.
+	 * \return iterator& Decremented iterator.
+	 *
+	 * The end is decremented to the biggest node of the tree in O(1), any other node to its predecessor.
+	 * Decrementing the first node gives the end.
+	 */
+	iterator& operator--() noexcept
+	{
+	  if(current)
+	    current = predecessor(current, is_threaded<N>{});
+	  else if(last)
+	    current = *last;
+	  return *this;
+	}
+
+	/**
+	 * \brief Overload of the post-decrement operator --.
+	 * \return iterator Iterator before moving to the previous node.
+	 */
+	iterator operator--(int) noexcept
+	{ iterator tmp {*this};
+	  --(*this);
+	  return tmp;
+	}
+
 	/**
 	 * \brief Overload of the operator ==.
 	 * \param x Iterator that is going to be on the left hand side of the operator.
@@ -116,13 +181,46 @@ template<class N, class I>
 iterator<N, I>& iterator<N,I>::operator++()
 {
 	if(current)
-  {
-    if(current->right)
-     current = current->right->findSmallest();
-    else
-     current = current->findBigger();
-   }
+    current = successor(current, is_threaded<N>{});
  return *this;
 }
 
+/**
+ * \brief View of the nodes of a tree between two iterators.
+ * \tparam I Type of the iterators.
+ *
+ * The view only stores its two bounds: the nodes are reached by the iterators while the range is visited,
+ * so nothing is copied.
+ */
+template<class I>
+class range_view
+{
+  I first;
+  I last;
+
+public:
+
+  /**
+   * \brief Constructor of the view of [f, l).
+   */
+  range_view(I f, I l) noexcept : first{f}, last{l} {}
+
+  using iterator = I;
+
+  /**
+   * \brief Function returning the first iterator of the view.
+   */
+  I begin() const noexcept { return first; }
+
+  /**
+   * \brief Function returning the iterator after the last element of the view.
+   */
+  I end() const noexcept { return last; }
+
+  /**
+   * \brief Function returning true if the view has no elements.
+   */
+  bool empty() const noexcept { return first == last; }
+};
+
 #endif
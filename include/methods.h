@@ -11,80 +11,227 @@
 #include<string>
 #include<vector>
 #include<algorithm>
+#include<stdexcept> //invalid_argument
 
 //copy semantics
-template<class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::copy(const std::unique_ptr<typename BST<Tk,Tv,Tc>::Node>& n)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::copy(const BST<Tk,Tv,Tc,Tb,Ta>& tree)
 {
-  if(n) //the node from which we have to copy is not empty
+  const Node* source = tree.root.get();
+  if(!source) return; //the tree from which we have to copy is empty
+  reserveNodes(tree, is_arena<Alloc>{});
+  cloneSubtree(source, root, nullptr);
+  threadTree(linked{}); //the links of the clones still point to the source
+  findEnds();
+}
+
+//clone a subtree (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::cloneSubtree(const typename BST<Tk,Tv,Tc,Tb,Ta>::Node* source, std::unique_ptr<typename BST<Tk,Tv,Tc,Tb,Ta>::Node,typename BST<Tk,Tv,Tc,Tb,Ta>::Deleter>& slot, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* parent)
+{
+  //clone the root, then go down both in the source and in the copy
+  slot.reset(newNode(source->data, parent));
+  static_cast<typename Tb::meta&>(*slot) = static_cast<const typename Tb::meta&>(*source);
+  Node* current = slot.get();
+  while(current != parent)
     {
-      (void)insert(n->data); //we purposely ignore the return type of insert
-      copy(n->left); //copy all left branch
-      copy(n->right); //copy all right branch
+      if(source->left && !current->left) //copy all left branch
+        {
+          source = source->left.get();
+          current->left.reset(newNode(source->data, current));
+          current = current->left.get();
+        }
+      else if(source->right && !current->right) //then the right one
+        {
+          source = source->right.get();
+          current->right.reset(newNode(source->data, current));
+          current = current->right.get();
+        }
+      else //both branches are done, go back up
+        {
+          source = source->parent;
+          current = current->parent;
+          continue;
+        }
+      static_cast<typename Tb::meta&>(*current) = static_cast<const typename Tb::meta&>(*source);
     }
 }
 
+//copy with several threads (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::copy(const BST<Tk,Tv,Tc,Tb,Ta>& tree, std::size_t threads)
+{
+  if(threads <= 1 || !std::is_same<Deleter, heap_delete>::value)
+  {
+    copy(tree);
+    return;
+  }
+  if(!tree.root) return;
+  task_pool pool{threads};
+  pool.run([this, &tree, &pool, threads]()
+           {
+             task_group group{pool};
+             cloneParallel(tree.root.get(), root, nullptr, taskDepth(threads), group);
+             group.wait();
+           });
+  threadTree(linked{});
+  findEnds();
+}
+
+//clone the top levels of a subtree with tasks (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::cloneParallel(const typename BST<Tk,Tv,Tc,Tb,Ta>::Node* source, std::unique_ptr<typename BST<Tk,Tv,Tc,Tb,Ta>::Node,typename BST<Tk,Tv,Tc,Tb,Ta>::Deleter>& slot, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* parent, std::size_t depth, task_group& group)
+{
+  if(!depth)
+  {
+    cloneSubtree(source, slot, parent);
+    return;
+  }
+  slot.reset(newNode(source->data, parent));
+  static_cast<typename Tb::meta&>(*slot) = static_cast<const typename Tb::meta&>(*source);
+  Node* n = slot.get();
+  //the two children are disjoint subtrees: the left one is cloned by another task
+  if(source->left)
+    group.spawn([this, source, n, depth, &group]() { cloneParallel(source->left.get(), n->left, n, depth-1, group); });
+  if(source->right)
+    cloneParallel(source->right.get(), n->right, n, depth-1, group);
+}
 
-template<class Tk, class Tv, class Tc>
-BST<Tk, Tv, Tc>& BST<Tk,Tv,Tc>::operator=(const BST<Tk, Tv, Tc>& tree)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+BST<Tk,Tv,Tc,Tb,Ta>& BST<Tk,Tv,Tc,Tb,Ta>::operator=(const BST<Tk,Tv,Tc,Tb,Ta>& tree)
 {
   #ifdef TEST
   std::cout<<"copy assignment"<<std::endl;
   #endif
+  if(this == &tree) return *this;
   //remove the content of the current tree
   clear();
-  copy(tree.root);
+  comp = tree.comp;
+  copy(tree);
   //deep copy all the input tree inside the current treee
   return *this;
 }
 
 //move semantics
-template<class Tk, class Tv, class Tc>
-BST<Tk, Tv, Tc>& BST<Tk,Tv,Tc>::operator=(BST<Tk, Tv, Tc>&& tree) noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+BST<Tk,Tv,Tc,Tb,Ta>& BST<Tk,Tv,Tc,Tb,Ta>::operator=(BST<Tk,Tv,Tc,Tb,Ta>&& tree) noexcept
 {
   #ifdef TEST
   std::cout<<"move assignment"<<std::endl;
   #endif
+  if(this == &tree) return *this;
+  clear();
   root=std::move(tree.root);
+  leftmost=tree.leftmost;
+  rightmost=tree.rightmost;
+  tree.leftmost=tree.rightmost=nullptr;
+  alloc=std::move(tree.alloc); //the nodes of the input tree belong to its allocator
+  comp=std::move(tree.comp);
   //move the content of input tree inside the current tree
   return *this;
 }
 
-//it begin
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Iterator BST<Tk,Tv,Tc>::begin() noexcept
+//node creation (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class... Args>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::newNode(Args&&... args)
 {
-  if(root)
+  if(std::is_same<Deleter, heap_delete>::value)
+    return new Node(std::forward<Args>(args)...);
+  using traits = std::allocator_traits<Alloc>;
+  Node* n = traits::allocate(alloc, 1);
+  try
   {
-  Node* n = root->findSmallest();
-  return Iterator{n};
+    traits::construct(alloc, n, std::forward<Args>(args)...);
   }
-  return Iterator{nullptr};
+  catch(...)
+  {
+    traits::deallocate(alloc, n, 1);
+    throw;
+  }
+  return n;
+}
+
+//node deletion (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::deleteNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n) noexcept
+{
+  if(std::is_same<Deleter, heap_delete>::value)
+  {
+    delete n;
+    return;
+  }
+  using traits = std::allocator_traits<Alloc>;
+  traits::destroy(alloc, n);
+  traits::deallocate(alloc, n, 1);
+}
+
+//delete a subtree (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::destroy(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n) noexcept
+{
+  while(n)
+  {
+    if(n->left)
+    { //rotate the left child up, the subtree is detached so parents are not needed
+      Node* l = n->left.release();
+      n->left.reset(l->right.release());
+      l->right.reset(n);
+      n = l;
+    }
+    else
+    {
+      Node* r = n->right.release();
+      deleteNode(n);
+      n = r;
+    }
+  }
+}
+
+//release all the nodes at once (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::releaseNodes(std::true_type) noexcept
+{
+  if(std::is_trivially_destructible<pair>::value)
+    (void)root.release(); //nothing to destroy, the memory goes away with the chunks
+  else
+    destroy(root.release());
+  alloc.release();
+}
+
+//it begin
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator BST<Tk,Tv,Tc,Tb,Ta>::begin() noexcept
+{
+  return iter(leftmost);
 }
 
 //const begin
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Const_iterator BST<Tk,Tv,Tc>::begin() const noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator BST<Tk,Tv,Tc,Tb,Ta>::begin() const noexcept
 {
-  if(!root) return Const_iterator{nullptr};
-  Node* n = root->findSmallest();
-  return Const_iterator{n};
+  return citer(leftmost);
 }
 
 //const cbegin
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Const_iterator BST<Tk,Tv,Tc>::cbegin() const noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator BST<Tk,Tv,Tc,Tb,Ta>::cbegin() const noexcept
 {
-  if(!root) return Const_iterator{nullptr};
-  Node* n = root->findSmallest();
-  return Const_iterator{n};
+  return citer(leftmost);
 }
 
 
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Iterator BST<Tk,Tv,Tc>::findnode(const Tk& x) const
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator BST<Tk,Tv,Tc,Tb,Ta>::findnode(const K& x) const
+{
+  return iter(findFrom(root.get(), x)); //starting from the root
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::findFrom(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* current, const K& x) const
 {
-  Node* current=root.get(); //starting from the root
   while(current)
     {
       //the key of the current node is smaller than k
@@ -92,7 +239,7 @@ typename BST<Tk,Tv,Tc>::Iterator BST<Tk,Tv,Tc>::findnode(const Tk& x) const
         {
           //have to search on the right child
           if(!(current->right.get())) //when there is no right child
-            return Iterator{current};
+            return current;
           else //when there is the right child we go down to the right
               current=current->right.get();
         }
@@ -101,21 +248,109 @@ typename BST<Tk,Tv,Tc>::Iterator BST<Tk,Tv,Tc>::findnode(const Tk& x) const
         {
           //heve to search on the left child
           if(!(current->left.get())) //when there is no left child
-            return Iterator{current};
+            return current;
           else //when there is the left child we go down to the left
             current = current->left.get();
         }
       else //equality case --> the key of the node is equal to key
-        return Iterator{current};
+        return current;
 
     }
   //if the root was nullptr-->empty tree
-  return Iterator{nullptr}; //iterator pointing to nullptr
+  return nullptr;
+}
+
+//exact search (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::findKey(const K& x) const
+{
+  Node* n = findFrom(root.get(), x);
+  //the search ends on the key, if present: it is equivalent to x if neither is smaller
+  return n && !comp(n->data.first, x) && !comp(x, n->data.first) ? n : nullptr;
+}
+
+//lower bound (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::lowerNode(const K& x) const
+{
+  Node* n = findFrom(root.get(), x);
+  //a search ending on a smaller key stopped at a node without right child: the next key is the first bigger ancestor
+  if(n && comp(n->data.first, x)) return n->findBigger();
+  return n; //the key x, or a bigger key whose predecessor is smaller than x
+}
+
+//upper bound (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::upperNode(const K& x) const
+{
+  Node* n = findFrom(root.get(), x);
+  if(!n || comp(x, n->data.first)) return n;
+  //n has the key x or a smaller one: the result is its successor
+  return n->right ? n->right->findSmallest() : n->findBigger();
+}
+
+//equal range (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Node*, typename BST<Tk,Tv,Tc,Tb,Ta>::Node*> BST<Tk,Tv,Tc,Tb,Ta>::equalNodes(const K& x) const
+{
+  Node* n = lowerNode(x);
+  if(!n || comp(x, n->data.first)) return std::make_pair(n, n);
+  return std::make_pair(n, (++iter(n)).node()); //one search for both bounds
+}
+
+//equal range
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator> BST<Tk,Tv,Tc,Tb,Ta>::equal_range(const Tk& x)
+{
+  auto n = equalNodes(x);
+  return std::make_pair(iter(n.first), iter(n.second));
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator, typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator> BST<Tk,Tv,Tc,Tb,Ta>::equal_range(const Tk& x) const
+{
+  auto n = equalNodes(x);
+  return std::make_pair(citer(n.first), citer(n.second));
+}
+
+//range view
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+range_view<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator> BST<Tk,Tv,Tc,Tb,Ta>::range(const Tk& lo, const Tk& hi)
+{
+  if(!comp(lo, hi)) return range_view<Iterator>{end(), end()};
+  return range_view<Iterator>{lower_bound(lo), lower_bound(hi)};
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+range_view<typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator> BST<Tk,Tv,Tc,Tb,Ta>::range(const Tk& lo, const Tk& hi) const
+{
+  if(!comp(lo, hi)) return range_view<Const_iterator>{cend(), cend()};
+  return range_view<Const_iterator>{lower_bound(lo), lower_bound(hi)};
+}
+
+//climb from a finger (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::climb(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* finger, const Tk& x) const
+{
+  if(!finger) return root.get();
+  //x is not smaller than the keys bounding finger from below: we only need a node bounding it from above
+  while(finger->parent)
+    {
+      Node* p = finger->parent;
+      if(p->left.get() == finger && comp(x, p->data.first))
+        break;
+      finger = p;
+    }
+  return finger;
 }
 
 //insert
-template<class Tk, class Tv, class Tc>
-std::pair<typename BST<Tk,Tv,Tc>::Iterator, bool> BST<Tk,Tv,Tc>::insert(const pair& x)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::insert(const pair& x)
 {
   #ifdef TEST
   std::cout<<std::endl;
@@ -125,8 +360,8 @@ std::pair<typename BST<Tk,Tv,Tc>::Iterator, bool> BST<Tk,Tv,Tc>::insert(const pa
 }
 
 //rvalue insert
-template<class Tk, class Tv, class Tc>
-std::pair<typename BST<Tk,Tv,Tc>::Iterator, bool> BST<Tk,Tv,Tc>::insert(pair&& x)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::insert(pair&& x)
 {
   #ifdef TEST
   std::cout<<std::endl;
@@ -135,299 +370,802 @@ std::pair<typename BST<Tk,Tv,Tc>::Iterator, bool> BST<Tk,Tv,Tc>::insert(pair&& x
   return insertPrivate(std::move(x));
 }
 
-template<class Tk, class Tv, class Tc>
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
 template<class T>
-std::pair<typename BST<Tk,Tv,Tc>::Iterator, bool> BST<Tk,Tv,Tc>::insertPrivate(T&& x)
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::insertPrivate(T&& x)
 {
   #ifdef TEST
   std::cout<<std::endl;
   std::cout<<"forward insert"<<std::endl;
   #endif
-    Node* current = root.get();
-    //Node* newnode=new Node(std::forward<T>(x),current);
-    while(current)
-    { //we have a node
-      if(comp(x.first, current->data.first))
-      {
-         if(current->left)
-         current = current->left.get();
-         else
-         {
-         current->left.reset(new Node(std::forward<T>(x),current));
-         return std::make_pair(Iterator{current->left.get()}, true);
-          }
-      }
-      else if(comp(current->data.first, x.first))
-      {
-          if(current->right)
-           current=current->right.get();
+  return linkNode(findnode(x.first).node(), x.first, std::forward<T>(x));
+}
+
+//link a new node where a search ended (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class... Args>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::linkNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* current, const Tk& key, Args&&... args)
+{
+  const bool left = current && comp(key, current->data.first);
+  if(current && !left && !comp(current->data.first, key))
+    return std::make_pair(iter(current), false);
+  //key may be a reference to the arguments: it is not used after the node has been built
+  Node* newnode = newNode(std::forward<Args>(args)..., current);
+  attachNode(current, newnode, left);
+  return std::make_pair(iter(newnode), true);
+}
+
+//search next to a hint (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::hintNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* hint, const Tk& key) const
+{
+  if(!root) return nullptr;
+  //the key is before the hint (or the end), it has to be after its predecessor
+  if(!hint || comp(key, hint->data.first))
+  {
+    Node* prev = hint ? (hint == leftmost ? nullptr : (--iter(hint)).node()) : rightmost;
+    if(!prev) return hint; //the smallest key: the leftmost node has no left child
+    if(comp(prev->data.first, key))
+      //the key goes between prev and hint: either hint has no left child, or prev (the largest of that subtree) has no right child
+      return hint && !hint->left ? hint : prev;
+  }
+  else if(comp(hint->data.first, key))
+  {
+    //the key is just after the hint: the mirror case
+    Node* next = hint == rightmost ? nullptr : (++iter(hint)).node();
+    if(!next || comp(key, next->data.first))
+      return !hint->right ? hint : next;
+  }
+  else
+    return hint; //the key of the hint
+  return findFrom(root.get(), key); //wrong hint
+}
+
+//link a node as a child of the node where a search ended (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::attachNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* current, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n, const bool left) noexcept
+{
+  n->parent = current;
+  if(!current) //root was empty
+  {
+    root.reset(n);
+    leftmost = rightmost = n;
+  }
+  else if(left)
+  {
+    current->left.reset(n);
+    if(current == leftmost) leftmost = n;
+  }
+  else
+  {
+    current->right.reset(n);
+    if(current == rightmost) rightmost = n;
+  }
+  resizePath(current, true, sized{});
+  threadNode(n, linked{});
+  insertFixup(n, Tb{}); //rotations never move n out of the tree
+}
+
+//batched find
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<typename BST<Tk,Tv,Tc,Tb,Ta>::Node*> BST<Tk,Tv,Tc,Tb,Ta>::findSorted(const std::vector<Tk>& keys) const
+{
+  std::vector<Node*> found(keys.size(), nullptr);
+  Node* finger = nullptr;
+  for(auto i: sortedOrder(keys))
+    {
+      finger = findFrom(climb(finger, keys[i]), keys[i]);
+      if(finger && !comp(finger->data.first, keys[i]) && !comp(keys[i], finger->data.first))
+        found[i] = finger;
+    }
+  return found;
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<std::size_t> BST<Tk,Tv,Tc,Tb,Ta>::sortedOrder(const std::vector<Tk>& keys) const
+{
+  std::vector<std::size_t> order(keys.size());
+  for(std::size_t i=0; i<order.size(); ++i)
+    order[i] = i;
+  //ties are broken by position, so that the sort is stable without the buffer of std::stable_sort
+  std::sort(order.begin(), order.end(),
+            [this, &keys](std::size_t a, std::size_t b)
+            { return comp(keys[a], keys[b]) || (!comp(keys[b], keys[a]) && a < b); });
+  return order;
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator> BST<Tk,Tv,Tc,Tb,Ta>::find_many(const std::vector<Tk>& keys)
+{
+  std::vector<Iterator> result;
+  result.reserve(keys.size());
+  for(Node* n: findSorted(keys))
+    result.push_back(iter(n));
+  return result;
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator> BST<Tk,Tv,Tc,Tb,Ta>::find_many(const std::vector<Tk>& keys) const
+{
+  std::vector<Const_iterator> result;
+  result.reserve(keys.size());
+  for(Node* n: findSorted(keys))
+    result.push_back(citer(n));
+  return result;
+}
+
+//interleaved group find
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator>
+BST<Tk,Tv,Tc,Tb,Ta>::find_group(const Tk* keys, const std::size_t count, const std::size_t width)
+{
+  std::vector<Iterator> result(count, end());
+  if(!root || count == 0) return result;
+  //a search in flight: the node it has reached and the index of its key
+  struct search
+  {
+    Node* current;
+    std::size_t key;
+  };
+  const std::size_t w = width ? width : 1; //searches kept in flight
+  std::vector<search> group;
+  group.reserve(w);
+  std::size_t next = 0; //next key to be started
+  while(next < count && group.size() < w)
+    group.push_back(search{root.get(), next++});
+  while(!group.empty())
+    {
+      for(std::size_t i=0; i<group.size(); )
+        {
+          search& s = group[i];
+          const Tk& x = keys[s.key];
+          Node* child;
+          if(comp(s.current->data.first, x))
+            child = s.current->right.get();
+          else if(comp(x, s.current->data.first))
+            child = s.current->left.get();
           else
-          {
-           current->right.reset(new Node(std::forward<T>(x),current));
-           return std::make_pair(Iterator{current->right.get()}, true);
-          }
-       }
-    else
+            {
+              result[s.key] = iter(s.current);
+              child = nullptr;
+            }
+          if(child)
+            {
+              //the node is loaded while the other searches are advanced
+              #if defined(__GNUC__)
+              __builtin_prefetch(child);
+              #endif
+              s.current = child;
+              ++i;
+            }
+          else if(next < count) //the search has ended: the slot takes the next key
+            s = search{root.get(), next++};
+          else
+            {
+              s = group.back();
+              group.pop_back();
+            }
+        }
+    }
+  return result;
+}
+
+//batched insert
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool>>
+BST<Tk,Tv,Tc,Tb,Ta>::insert_many(const std::vector<std::pair<Tk,Tv>>& values)
+{
+  std::vector<Tk> keys;
+  keys.reserve(values.size());
+  for(auto& x: values)
+    keys.push_back(x.first);
+  std::vector<std::pair<Iterator, bool>> result(values.size());
+  Node* finger = nullptr;
+  for(auto i: sortedOrder(keys)) //stable: among equal keys the first one is inserted
     {
-      return std::make_pair(Iterator{current}, false);
+      result[i] = linkNode(findFrom(climb(finger, keys[i]), keys[i]), keys[i], values[i]);
+      finger = result[i].first.node(); //the new node, or the one which already had the key
     }
+  return result;
 }
-    //root was empty
-    root.reset(new Node(std::forward<T>(x),nullptr));
-    return std::make_pair(Iterator{root.get()}, true);
 
+//batched erase
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::erase_many(const std::vector<Tk>& keys)
+{
+  std::vector<Node*> found = findSorted(keys);
+  //the same key may appear more than once in the batch
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+  std::size_t count = 0;
+  for(Node* n: found)
+    if(n)
+      {
+        eraseNode(n); //the other nodes are not moved in memory, so their pointers stay valid
+        ++count;
+      }
+  return count;
 }
 
 //find
 //non-const version
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Iterator BST<Tk,Tv,Tc>::find(const Tk& x)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator BST<Tk,Tv,Tc,Tb,Ta>::find(const Tk& x)
 {
   #ifdef TEST
   std::cout<<"non-const find"<<std::endl;
   #endif
-  Iterator it{this->findnode(x)};
-  if(it!=end())
-    return (((*it).first == x )? it : end());
-  else //tree is empty
-    return end();
+  return iter(findKey(x)); //end() if the tree is empty or the key is missing
 }
 
 //const version
-template<class Tk, class Tv, class Tc>
-typename BST<Tk,Tv,Tc>::Const_iterator BST<Tk,Tv,Tc>::find(const Tk& x) const
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Const_iterator BST<Tk,Tv,Tc,Tb,Ta>::find(const Tk& x) const
 {
   #ifdef TEST
   std::cout<<"const find"<<std::endl;
   #endif
-  Const_iterator it{this->findnode(x)};
-  if(it!=end())
-    return (*it).first == x ? it : cend();
-  else
-    return cend();
+  return citer(findKey(x));
 }
 
 //operator []
-template<class Tk, class Tv, class Tc>
-Tv& BST<Tk,Tv,Tc>::operator[](const Tk& k)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+Tv& BST<Tk,Tv,Tc,Tb,Ta>::operator[](const Tk& k)
 {
   #ifdef TEST
   std::cout<<std::endl;
   std::cout<<"lvalue []"<<std::endl;
   #endif
-  //insert doesn't modify the tree if the key is already present
-  const pair p{k, Tv{}}; //second argument default ctor
-  Iterator it{insert(p).first};
-  return it->second;
+  //the value is default constructed only if the key is not in the tree
+  return try_emplace(k).first->second;
 }
 
 
-template<class Tk, class Tv, class Tc>
-Tv& BST<Tk,Tv,Tc>::operator[](Tk&& k)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+Tv& BST<Tk,Tv,Tc,Tb,Ta>::operator[](Tk&& k)
 {
   #ifdef TEST
   std::cout<<std::endl;
   std::cout<<"rvalue []"<<std::endl;
   #endif
-  pair p{k, Tv{}}; //second argument default ctor
-  Iterator it{insert(std::move(p)).first}; //rvalue insert
-  return it->second;
+  return try_emplace(std::move(k)).first->second; //the key is moved in the new node
+}
+
+//insert or assign
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class M>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::insert_or_assign(const Tk& k, M&& obj)
+{
+  auto result = try_emplace(k, std::forward<M>(obj));
+  if(!result.second) result.first->second = std::forward<M>(obj); //obj has not been used by try_emplace
+  return result;
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class M>
+std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator, bool> BST<Tk,Tv,Tc,Tb,Ta>::insert_or_assign(Tk&& k, M&& obj)
+{
+  auto result = try_emplace(std::move(k), std::forward<M>(obj));
+  if(!result.second) result.first->second = std::forward<M>(obj);
+  return result;
 }
 
 //erase
-template<class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::erase(const Tk& data)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::erase(const Tk& data)
+{
+  eraseKey(data);
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class K>
+void BST<Tk,Tv,Tc,Tb,Ta>::eraseKey(const K& data)
 {
  if(!root) {std::cout<<"Empty tree"<<std::endl;}
  else //tree is not empty
  {
-   Iterator it{find(data)};
-   if(it == end()) {std::cout<<"key is not in the tree"<<std::endl;}
-   else
-   {
-     if(it.node()==root.get()) //need to remove the root
-       { RemoveRootMach();}
-     else
-     {
-       Node* match = it.node();
-       Node* parent = match->parent;
-       //need to decide if it is left or right child
-       if(parent->left.get() == match)
-         {RemoveMatch(parent, match, true);}
-       else {RemoveMatch(parent, match, false);}
-     }
-   }
+   Node* n = findKey(data);
+   if(!n) {std::cout<<"key is not in the tree"<<std::endl;}
+   else eraseNode(n);
  }
 }
 
-//remove root
-template <class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::RemoveRootMach(){
- //case 0 root have not a chldren
- if(!(root->left) && !(root->right))
- {
-   root.reset(); //clear the tree
- }
- //case 1 root has one child --> right child
- else if (!(BST<Tk,Tv,Tc>::root->left.get()) && BST<Tk,Tv,Tc>::root->right.get())
-      {
-	root->right->parent = nullptr;
-	root.reset(root->right.release());
-        #ifdef TEST
- 	std::cout<<"The new root contains data " << root->data.first <<std::endl;
-        #endif
-      }
-      //case 1 root has one child --> left child
-      else if ((root->left) && !(root->right))
-           {
-	     root->left->parent = nullptr;
-	     //root point to the left child (left child = current root)
-	     root.reset(root->left.release());
-             #ifdef TEST
-	      std::cout<<"The new root contains data " << root->data.first <<std::endl;
-             #endif
-           }
-	   //case 2 the root has 2 children
-	   else
-           {
-	     Node* temp = (root->right.get())->findSmallest();
-	     if(comp(temp->data.first,temp->parent->data.first))
-           {
-      if(temp->right) temp->right->parent = temp->parent;
+//unlink a node (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::unlinkNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* z) noexcept
+{
+  std::unique_ptr<Node,Deleter>& zslot = slot(z); //the pointer owning z
+  if(z == leftmost) leftmost = (++iter(z)).node();
+  if(z == rightmost) rightmost = (--iter(z)).node();
+  Node* parent = z->parent;
+  Node* x; //node taking the place of the removed position
+  Node* xp; //parent of x
+  if(!(z->left) || !(z->right))
+  {
+    //case 0 and 1: at most one child, which takes the place of z
+    x = z->left ? z->left.release() : z->right.release();
+    xp = parent;
+    zslot.release();
+    zslot.reset(x);
+    if(x) x->parent = parent;
+  }
+  else
+  {
+    //case 2: both children, z is replaced by its inorder successor y
+    Node* y = z->right->findSmallest();
+    if(y->parent == z)
+    {
+      z->right.release();
+      x = y->right.get();
+      xp = y;
+    }
+    else
+    {
+      //y is the leftmost node of the right subtree: its right child takes its place
+      xp = y->parent;
+      x = y->right.release();
+      xp->left.release();
+      xp->left.reset(x);
+      if(x) x->parent = xp;
+      y->right.reset(z->right.release());
+      y->right->parent = y;
+    }
+    y->left.reset(z->left.release());
+    y->left->parent = y;
+    zslot.release();
+    zslot.reset(y);
+    y->parent = parent;
+    //y now sits in the position of z: the two nodes exchange their bookkeeping data,
+    //so that z carries the data of the position which has actually been removed
+    std::swap(static_cast<typename Tb::meta&>(*y), static_cast<typename Tb::meta&>(*z));
+    keepLinks(y, z, linked{}); //the links belong to the nodes, not to the positions
+  }
+  #ifdef TEST
+  std::cout<<"the node containing the data " << z->data.first<< " was removed"<<std::endl;
+  #endif
+  resizePath(xp, false, sized{}); //xp is the parent of the removed position
+  unthreadNode(z, linked{});
+  eraseFixup(x, xp, z, Tb{});
+  //z leaves the tree as a single node, ready to be linked again
+  static_cast<typename Tb::meta&>(*z) = typename Tb::meta{};
+  z->parent = nullptr;
+}
+
+//extract
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::node_type BST<Tk,Tv,Tc,Tb,Ta>::extract(const Tk& k)
+{
+  Iterator it{find(k)};
+  if(it == end()) return node_type{};
+  return extract(it);
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::node_type BST<Tk,Tv,Tc,Tb,Ta>::extract(typename BST<Tk,Tv,Tc,Tb,Ta>::Iterator pos) noexcept
+{
+  static_assert(std::is_same<Deleter, heap_delete>::value, "node handles need the nodes to be allocated with new");
+  unlinkNode(pos.node());
+  return node_type{pos.node()};
+}
+
+//insert a node handle
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::insert_return_type BST<Tk,Tv,Tc,Tb,Ta>::insert(typename BST<Tk,Tv,Tc,Tb,Ta>::node_type&& nh)
+{
+  static_assert(std::is_same<Deleter, heap_delete>::value, "node handles need the nodes to be allocated with new");
+  if(!nh) return insert_return_type{end(), false, node_type{}};
+  Node* current = findFrom(root.get(), nh.key());
+  const bool left = current && comp(nh.key(), current->data.first);
+  if(current && !left && !comp(current->data.first, nh.key()))
+    return insert_return_type{iter(current), false, std::move(nh)};
+  Node* n = nh.release();
+  attachNode(current, n, left);
+  return insert_return_type{iter(n), true, node_type{}};
+}
 
-      temp->parent->left.release();
+//merge
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::merge(BST& other)
+{
+  static_assert(std::is_same<Deleter, heap_delete>::value, "merge needs the nodes to be allocated with new");
+  if(&other == this) return;
+  Node* finger = nullptr;
+  Node* next;
+  for(Node* n = other.leftmost; n; n = next)
+  {
+    next = (++other.iter(n)).node(); //unlinking n does not move the other nodes
+    const Tk& k = n->data.first;
+    Node* current = findFrom(climb(finger, k), k);
+    const bool left = current && comp(k, current->data.first);
+    if(current && !left && !comp(current->data.first, k))
+    {
+      finger = current; //the key is already in the tree, the node stays in other
+      continue;
+    }
+    other.unlinkNode(n);
+    attachNode(current, n, left);
+    finger = n;
+  }
+}
+
+//join with a node and a tree of bigger keys (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+int BST<Tk,Tv,Tc,Tb,Ta>::joinAt(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* k, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* b,
+                                int, int, unbalanced) noexcept
+{
+  k->left.reset(root.release());
+  k->right.reset(b);
+  if(k->left) k->left->parent = k;
+  if(b) b->parent = k;
+  k->parent = nullptr;
+  sumSize(k, sized{});
+  root.reset(k);
+  return 0;
+}
+
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+int BST<Tk,Tv,Tc,Tb,Ta>::joinAt(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* k, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* b,
+                                int ha, int hb, red_black) noexcept
+{
+  //the roots must be black, so that a red node is never linked under a red root
+  ha += blacken(root.get(), Tb{});
+  hb += blacken(b, Tb{});
+  const bool right = ha >= hb; //k is linked on the right spine of the tree, or on the left spine of b
+  Node* other = right ? b : root.release(); //the shorter tree
+  if(!right) root.reset(b);
+  const int h0 = right ? hb : ha;
+  int h = right ? ha : hb;
+  //walk down the spine of the taller tree to the first black node with the black height of the shorter tree
+  Node* p = nullptr;
+  Node* c = root.get();
+  while(c && !(!c->red && h == h0))
+  {
+    h -= !c->red;
+    p = c;
+    c = right ? c->right.get() : c->left.get();
+  }
+  std::unique_ptr<Node,Deleter>& cslot = p ? (right ? p->right : p->left) : root;
+  cslot.release();
+  if(right)
+  {
+    k->left.reset(c);
+    k->right.reset(other);
+  }
+  else
+  {
+    k->left.reset(other);
+    k->right.reset(c);
+  }
+  if(c) c->parent = k;
+  if(other) other->parent = k;
+  k->parent = p;
+  cslot.reset(k);
+  sumSize(k, sized{});
+  growPath(p, other, sized{});
+  return std::max(ha, hb) + insertFixup(k, Tb{}); //k is red, as a new node
+}
+
+//split
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+BST<Tk,Tv,Tc,Tb,Ta> BST<Tk,Tv,Tc,Tb,Ta>::split(const Tk& x)
+{
+  static_assert(std::is_same<Deleter, heap_delete>::value, "split needs the nodes to be allocated with new");
+  BST right;
+  right.comp = comp;
+  cutLinks(lowerNode(x), linked{});
+  //a piece of the search path: a node and the subtree which stays on its side of x
+  struct piece { Node* node; Node* sub; int height; };
+  std::vector<piece> smaller, bigger;
+  int h = blackHeight();
+  Node* n = root.release();
+  while(n)
+  {
+    Node* l = n->left.release();
+    Node* r = n->right.release();
+    if(l) l->parent = nullptr;
+    if(r) r->parent = nullptr;
+    h -= blackOf(n, Tb{}); //black height of the children
+    if(comp(n->data.first, x))
+    {
+      smaller.push_back(piece{n, l, h});
+      n = r;
+    }
+    else
+    {
+      bigger.push_back(piece{n, r, h});
+      n = l;
+    }
+  }
+  //join the pieces from the bottom: the deepest ones are the nearest to x
+  int hl = 0; //black height of the tree built so far on each side
+  for(auto p = smaller.rbegin(); p != smaller.rend(); ++p)
+  {
+    Node* b = root.release();
+    root.reset(p->sub);
+    hl = joinAt(p->node, b, p->height, hl, Tb{});
+  }
+  int hr = 0;
+  for(auto p = bigger.rbegin(); p != bigger.rend(); ++p)
+    hr = right.joinAt(p->node, p->sub, hr, p->height, Tb{});
+  findEnds();
+  right.findEnds();
+  return right;
+}
+
+//join
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::join(BST&& other)
+{
+  static_assert(std::is_same<Deleter, heap_delete>::value, "join needs the nodes to be allocated with new");
+  if(&other == this || !other.root) return;
+  if(!root)
+  {
+    *this = std::move(other);
+    return;
+  }
+  if(!comp(rightmost->data.first, other.leftmost->data.first))
+    throw std::invalid_argument{"join: the keys of the trees are not in order"};
+  Node* k = other.leftmost;
+  other.unlinkNode(k);
+  joinLinks(rightmost, k, linked{});
+  joinLinks(k, other.leftmost, linked{});
+  rightmost = other.rightmost ? other.rightmost : k;
+  const int ha = blackHeight();
+  const int hb = other.blackHeight();
+  joinAt(k, other.root.release(), ha, hb, Tb{});
+  other.leftmost = other.rightmost = nullptr;
+}
+
+//rotations
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::rotateLeft(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* x) noexcept
+{
+  std::unique_ptr<Node,Deleter>& xslot = slot(x);
+  Node* y = x->right.release();
+  x->right.reset(y->left.release()); //left subtree of y becomes right subtree of x
+  if(x->right) x->right->parent = x;
+  xslot.release();
+  xslot.reset(y); //y takes the place of x
+  y->parent = x->parent;
+  y->left.reset(x);
+  x->parent = y;
+  rotated(x, y, sized{});
+}
+
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::rotateRight(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* x) noexcept
+{
+  std::unique_ptr<Node,Deleter>& xslot = slot(x);
+  Node* y = x->left.release();
+  x->left.reset(y->right.release()); //right subtree of y becomes left subtree of x
+  if(x->left) x->left->parent = x;
+  xslot.release();
+  xslot.reset(y); //y takes the place of x
+  y->parent = x->parent;
+  y->right.reset(x);
+  x->parent = y;
+  rotated(x, y, sized{});
+}
+
+//red-black insertion fixup
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+bool BST<Tk,Tv,Tc,Tb,Ta>::insertFixup(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n, red_black) noexcept
+{
+  n->red = true;
+  //a red node cannot have a red parent
+  while(n->parent && n->parent->red)
+  {
+    Node* p = n->parent;
+    Node* g = p->parent; //exists because the root is black
+    if(p == g->left.get())
+    {
+      Node* u = g->right.get();
+      if(u && u->red) //red uncle: recolour and go up
+      {
+        p->red = false; u->red = false; g->red = true;
+        n = g;
       }
       else
       {
-	temp->parent->right.release();
-	temp->parent = nullptr;
+        if(n == p->right.get()) //inner child: move it outside
+        {
+          rotateLeft(p);
+          std::swap(n, p);
+        }
+        p->red = false; g->red = true;
+        rotateRight(g);
       }
-      if(root->left)
+    }
+    else //mirror case
+    {
+      Node* u = g->left.get();
+      if(u && u->red)
       {
-	root->left->parent = temp;
-	temp->left.reset(root->left.release());
+        p->red = false; u->red = false; g->red = true;
+        n = g;
       }
-      if(root->right)
+      else
       {
-        Node * tempright = root->right.release();
-	root->right->parent = temp;
-        temp->parent->left.reset(temp->right.release());
-	temp->right.reset(tempright);
-        temp->parent = nullptr;
-        delete tempright;
+        if(n == p->left.get())
+        {
+          rotateRight(p);
+          std::swap(n, p);
+        }
+        p->red = false; g->red = true;
+        rotateLeft(g);
       }
-      root.reset(temp);
-      #ifdef TEST
-        std::cout << "the root was overwitten with key "<< root->data.first<<std::endl;	//allert of the change
-      #endif
     }
+  }
+  const bool grew = root->red; //a red root is blackened, adding a black node to every path
+  root->red = false;
+  return grew;
 }
 
-//remove node
-template <class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::RemoveMatch(typename BST<Tk,Tv,Tc>::Node* parent,typename BST<Tk,Tv,Tc>::Node* match, const bool left)
+//red-black erase fixup
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::eraseFixup(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* x, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* xp,
+                                  typename BST<Tk,Tv,Tc,Tb,Ta>::Node* removed, red_black) noexcept
 {
- //case 0 no children
- if(!(match->left) && !(match->right))
- {
-   left == true ?							//the node that we want delete is the left child of its parent?
-   parent->left.reset() :			//if yes put the parent's left pointer to nullptr
-   parent->right.reset();			//esle no put the parent's right pointr to nullptr
-   #ifdef TEST
-    cout<<"the node containing the data " << match->data.first<< " was removed"<<endl;
-   #endif
- }
- //case 1 one child --> right
- else if(!(match->left) && (match->right))
+  if(removed->red) return; //removing a red position does not change black heights
+  //x carries an extra black: push it up until it reaches a red node or the root
+  while(x != root.get() && !(x && x->red))
+  {
+    if(x == xp->left.get())
+    {
+      Node* w = xp->right.get(); //sibling, never nullptr
+      if(w->red)
       {
-	if(left == true)
-        {							//the node that we want delete is the left child of its parent?
-          parent->left.release();
-          match->right->parent = parent;
-          parent->left.reset(match->right.release());		//if yes put the parent's left pointer to the left pointr of the node that we want delete
-          delete match;
-	}
-	else
+        w->red = false; xp->red = true;
+        rotateLeft(xp);
+        w = xp->right.get();
+      }
+      if(!(w->left && w->left->red) && !(w->right && w->right->red))
+      {
+        w->red = true;
+        x = xp;
+        xp = x->parent;
+      }
+      else
+      {
+        if(!(w->right && w->right->red))
         {
-          parent->right.release();
-	  parent->right.reset(match->right.release());
-	  parent->right->parent = parent;
-	  delete match; //delete the node
-	}
-        #ifdef TEST
-	 std::cout<<"the node containing the data " << match->data.first<< " was removed"<<std::endl;
-        #endif
-       }
-     //case 1 one child --> left
-     else if((match->left) && !(match->right))
-          {
-	    if(left == true)
-            {	//is the node that we want delete the left child of its parent?
-              parent->left.release();
-	      parent->left.reset(match->left.release());		//if yes put the parent's left ptr to the left ptr of the node that we want delete
-	      parent->left->parent = parent;
-	      delete match;
-	    }
-	    else
-            {
-              parent->right.release();
-	      parent->right.reset(match->left.release());
-	      parent->right->parent = parent;
-	      delete match;
-	    }
-            #ifdef TEST
-	      cout<<"the node containing the data " << match->data.fisrt<< " was removed"<<endl;
-            #endif
-          }
-          //case 2 --> both children
-          else
-          {
-	    Node* temp = (match->right.get())->findSmallest();
-	    if(comp(temp->data.first, temp->parent->data.first))
-             {
-	       temp->parent->left.release();
-	       temp->right->parent = temp->parent;
-               if(!(temp->right)) temp->parent->left.reset(temp->right.release());
-	     }
-	     else
-             {
-	       temp->parent->right.release();
-	       temp->parent = nullptr;
-	     }
-
-     if(left == true)
-     {
-       parent->left.release();
-       parent->left.reset(temp);
-       temp->parent = parent;
-     }
-     else
-     {
-       parent->right.release();
-       parent->right.reset(temp);
-       temp->parent = parent;
-     }
-     if (match->left)
-     {
-       match->left->parent = temp;
-       temp->left.reset(match->left.release());
-     }
-     if (match->right)
-     {
-       match->right->parent = temp;
-       temp->right.reset(match->right.release());
-     }
-   delete match;
+          w->left->red = false; w->red = true;
+          rotateRight(w);
+          w = xp->right.get();
+        }
+        w->red = xp->red; xp->red = false; w->right->red = false;
+        rotateLeft(xp);
+        x = root.get();
+      }
+    }
+    else //mirror case
+    {
+      Node* w = xp->left.get();
+      if(w->red)
+      {
+        w->red = false; xp->red = true;
+        rotateRight(xp);
+        w = xp->left.get();
+      }
+      if(!(w->left && w->left->red) && !(w->right && w->right->red))
+      {
+        w->red = true;
+        x = xp;
+        xp = x->parent;
+      }
+      else
+      {
+        if(!(w->left && w->left->red))
+        {
+          w->right->red = false; w->red = true;
+          rotateLeft(w);
+          w = xp->left.get();
+        }
+        w->red = xp->red; xp->red = false; w->left->red = false;
+        rotateRight(xp);
+        x = root.get();
+      }
+    }
+  }
+  if(x) x->red = false;
+}
+
+//link a new leaf to its neighbours (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::threadNode(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n, std::true_type) noexcept
+{
+  Node* p = n->parent;
+  if(!p) return; //the only node of the tree
+  if(p->left.get() == n) //n comes just before its parent
+  {
+    n->prev = p->prev;
+    n->next = p;
+  }
+  else //n comes just after its parent
+  {
+    n->prev = p;
+    n->next = p->next;
   }
+  if(n->prev) n->prev->next = n;
+  if(n->next) n->next->prev = n;
 }
 
+//link all the nodes in key order (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::threadTree(std::true_type) noexcept
+{
+  if(!root) return;
+  Node* prev = nullptr;
+  for(Node* n = root->findSmallest(); n; prev = n, n = n->right ? n->right->findSmallest() : n->findBigger())
+  {
+    n->prev = prev;
+    n->next = nullptr;
+    if(prev) prev->next = n;
+  }
+}
 
+//select the k-th node (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::selectNode(std::size_t k) const noexcept
+{
+  static_assert(sized::value, "select and advance need the order_statistics policy");
+  Node* n = root.get();
+  while(n)
+  {
+    std::size_t left = sizeOf(n->left.get());
+    if(k < left)
+      n = n->left.get();
+    else if(k == left)
+      return n;
+    else
+    {
+      k -= left+1; //skip the left subtree and n
+      n = n->right.get();
+    }
+  }
+  return nullptr;
+}
+
+//position of a node (private)
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::position(const typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n) const noexcept
+{
+  static_assert(sized::value, "advance needs the order_statistics policy");
+  if(!n) return sizeOf(root.get()); //end
+  std::size_t k = sizeOf(n->left.get());
+  for(; n->parent; n = n->parent)
+    if(n->parent->right.get() == n) //the parent and its left subtree come before n
+      k += sizeOf(n->parent->left.get()) + 1;
+  return k;
+}
+
+//rank
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::rank(const Tk& x) const
+{
+  static_assert(sized::value, "rank needs the order_statistics policy");
+  std::size_t k = 0;
+  const Node* n = root.get();
+  while(n)
+  {
+    if(comp(x, n->data.first))
+      n = n->left.get();
+    else if(comp(n->data.first, x))
+    {
+      k += sizeOf(n->left.get()) + 1;
+      n = n->right.get();
+    }
+    else
+      return k + sizeOf(n->left.get());
+  }
+  return k;
+}
 
 //print the relation between a node and its children
-template <class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::PrintChildren(Tk a)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::PrintChildren(Tk a)
 {
-  BST<Tk,Tv,Tc>::Node* ptr = BST<Tk,Tv,Tc>::find(a).node();	//create the pointer that will be use point the node with the data that we serch         																			
+  BST<Tk,Tv,Tc,Tb,Ta>::Node* ptr = BST<Tk,Tv,Tc,Tb,Ta>::find(a).node();	//create the pointer that will be use point the node with the data that we serch         																			
   if (ptr)
   {														//if ptr NOT point to null
     std::cout<<std::endl;
@@ -447,55 +1185,420 @@ void BST<Tk,Tv,Tc>::PrintChildren(Tk a)
   }
 }
 
+//freeze
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+FrozenBST<Tk,Tv,Tc> BST<Tk,Tv,Tc,Tb,Ta>::freeze() const
+{
+  return FrozenBST<Tk,Tv,Tc>{cbegin(), cend(), comp};
+}
+
+//save
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::save(const std::string& path) const
+{
+  freeze().save(path);
+}
+
+//serialize
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class W, class KC, class VC>
+void BST<Tk,Tv,Tc,Tb,Ta>::serialize(W&& writer, std::size_t chunk, KC kc, VC vc) const
+{
+  writer("BSTS\x01", 5); //magic and version
+  std::string buffer, header;
+  buffer.reserve(chunk + 64);
+  std::size_t pairs = 0;
+  auto flush = [&]()
+    {
+      if(buffer.size() > max_chunk_size) throw std::length_error{"serialize: chunk bigger than max_chunk_size"};
+      header.clear();
+      put_varint(header, pairs);
+      put_varint(header, buffer.size());
+      writer(header.data(), header.size());
+      writer(buffer.data(), buffer.size());
+      buffer.clear();
+      pairs = 0;
+      kc.reset();
+      vc.reset();
+    };
+  kc.reset();
+  vc.reset();
+  for(const auto& x: *this)
+    {
+      kc.encode(buffer, x.first);
+      vc.encode(buffer, x.second);
+      ++pairs;
+      if(buffer.size() >= chunk)
+        flush();
+    }
+  if(pairs) flush();
+  writer("", 1); //chunk with no pairs, end of the stream
+}
+
+//deserialize
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template<class R, class KC, class VC>
+void BST<Tk,Tv,Tc,Tb,Ta>::deserialize(R&& reader, KC kc, VC vc)
+{
+  char magic[5];
+  if(reader(magic, 5) != 5 || std::memcmp(magic, "BSTS\x01", 5) != 0)
+    throw std::runtime_error{"deserialize: not a serialized tree"};
+  std::vector<std::pair<Tk,Tv>> values;
+  std::string buffer;
+  while(std::uint64_t pairs = read_varint(reader))
+    {
+      std::uint64_t bytes = read_varint(reader);
+      //checked before allocating the buffer: every pair takes at least one byte
+      if(bytes > max_chunk_size || pairs > bytes) throw std::runtime_error{"deserialize: corrupted chunk size"};
+      buffer.resize(bytes);
+      if(reader(&buffer[0], bytes) != bytes) throw std::runtime_error{"deserialize: truncated stream"};
+      const char* in = buffer.data();
+      const char* end = in + bytes;
+      kc.reset();
+      vc.reset();
+      for(std::uint64_t i=0; i<pairs; ++i)
+        {
+          Tk k = kc.decode(in, end);
+          values.emplace_back(std::move(k), vc.decode(in, end));
+        }
+      if(in != end) throw std::runtime_error{"deserialize: corrupted chunk"};
+    }
+  //already sorted: assign builds the tree directly
+  assign(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+}
+
 //Balance
-template <class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::Balance()
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::Balance()
 {
-  std::vector<std::pair<Tk,Tv>> v;					//create the vector for save all the values in the tree
-  v = BalancePrivate(); //arg root		//call balanceprevate function for save the values. Remember that return a vector
-  clear(); //
-  #ifdef TEST
-    for(int i = 0; i<v.size();i++) std::<<v[i].first<<" "<<v[i].second<<" \\"; std::cout<<std::endl;
-  #endif
-  rebuildtree(v, 0, v.size()-1);						//create a new tree pefectly balance.
+  std::size_t n = treeToVine(); //all the nodes on the right spine, in ascending order
+  if(n < 2) return;
+  //nodes exceeding the biggest perfect tree with at most n nodes: they form the last level
+  std::size_t perfect = 1;
+  while(perfect <= (n+1)/2) perfect *= 2;
+  std::size_t leaves = n + 1 - perfect;
+  compress(leaves, true);
+  std::size_t size = n - leaves;
+  while(size > 1) //every pass halves the length of the right spine
+  {
+    size /= 2;
+    compress(size, false);
+  }
 }
 
-//rebuild the tree in balance version
-template <class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::rebuildtree (std::vector<std::pair<Tk,Tv>>& values, int start, int end)
+//Balance with several threads
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::Balance(std::size_t threads)
 {
-  if(start > end)
-  {						/*if the start point is equal to the end point.
-   		  it means that all the value in the vector were been put inside the new balance tree*/
-    return;								//you put all value. Finish
+  if(threads <= 1)
+  {
+    Balance();
+    return;
   }
+  const std::vector<std::pair<Node*,bool>> items = chunks(threads);
+  task_pool pool{threads};
+  pool.run([this, &pool, &items]()
+           {
+             //the subtrees are collected by parallel tasks, then concatenated
+             std::vector<std::vector<Node*>> pieces(items.size());
+             task_group group{pool};
+             for(std::size_t i=0; i<items.size(); ++i)
+               if(items[i].second)
+                 group.spawn([&items, &pieces, i]() { visit(items[i].first, [&pieces, i](Node* n) { pieces[i].push_back(n); }); });
+               else
+                 pieces[i].push_back(items[i].first);
+             group.wait();
+             std::vector<std::size_t> offsets(pieces.size()+1, 0);
+             for(std::size_t i=0; i<pieces.size(); ++i)
+               offsets[i+1] = offsets[i] + pieces[i].size();
+             std::vector<Node*> nodes(offsets.back());
+             for(std::size_t i=0; i<pieces.size(); ++i)
+               group.spawn([&nodes, &pieces, &offsets, i]()
+                           {
+                             std::copy(pieces[i].begin(), pieces[i].end(), nodes.begin()+offsets[i]);
+                             std::vector<Node*>{}.swap(pieces[i]);
+                           });
+             group.wait();
+             //from here on nothing can fail: the nodes are relinked as a balanced tree
+             root.release();
+             Node* r = relink(nodes.data(), nodes.size(), 0, bottomLevel(nodes.size()), nullptr, &group);
+             group.wait();
+             root.reset(r);
+           });
+}
 
-  int middle = (end+start)/2;				//calculate the middle point in the vector. In the middle there is the intermediate value
-  insert(values[middle]);					//insert in the tree the intermediate value
-  rebuildtree(values,start,middle-1);	//recall the function to repeat the procedure
-  rebuildtree(values, middle+1, end);
+//split the tree in chunks (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+std::vector<std::pair<typename BST<Tk,Tv,Tc,Tb,Ta>::Node*, bool>> BST<Tk,Tv,Tc,Tb,Ta>::chunks(std::size_t threads) const
+{
+  std::vector<std::pair<Node*, bool>> items; //node, true if it is the root of a subtree at depth
+  if(threads <= 1)
+  {
+    if(root) items.push_back({root.get(), true});
+    return items;
+  }
+  //in-order sequence of the nodes above depth, and of the subtrees rooted at depth
+  const std::size_t depth = taskDepth(threads);
+  std::vector<std::pair<Node*, std::size_t>> stack;
+  Node* n = root.get();
+  std::size_t d = 0;
+  for(;;)
+  {
+    for(; n && d<depth; ++d)
+    {
+      stack.push_back({n, d});
+      n = n->left.get();
+    }
+    if(n) items.push_back({n, true});
+    if(stack.empty()) break;
+    n = stack.back().first;
+    d = stack.back().second + 1;
+    stack.pop_back();
+    items.push_back({n, false});
+    n = n->right.get();
+  }
+  return items;
 }
 
-//save nodes of before the balance
-template <class Tk, class Tv, class Tc>
-std::vector<std::pair<Tk,Tv>> BST<Tk,Tv,Tc>::BalancePrivate()
+//visit the nodes of a subtree in order (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class F>
+void BST<Tk,Tv,Tc,Tb,Ta>::visit(typename BST<Tk,Tv,Tc,Tb,Ta>::Node* n, F f)
 {
-  std::vector<std::pair<Tk,Tv>> values;					//vector for saving the values
-  Iterator start{this->begin()};
-  Iterator end{this->end()};
-  if(start==end) //tree is Empty
-    return values;
-  else
+  std::vector<Node*> stack;
+  while(n || !stack.empty())
+  {
+    for(; n; n = n->left.get())
+      stack.push_back(n);
+    n = stack.back();
+    stack.pop_back();
+    f(n);
+    n = n->right.get();
+  }
+}
+
+//process the chunks of the tree with several threads (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class F>
+void BST<Tk,Tv,Tc,Tb,Ta>::forChunks(const std::vector<std::pair<Node*,bool>>& items, std::size_t threads, F f) const
+{
+  if(threads <= 1)
   {
-    for(; start!=end; ++start)
-      {values.push_back(*start);}
-    return values;
+    for(std::size_t i=0; i<items.size(); ++i)
+      f(i);
+    return;
   }
+  task_pool pool{threads};
+  pool.run([&pool, &items, &f]()
+           {
+             task_group group{pool};
+             for(std::size_t i=0; i<items.size(); ++i)
+               if(items[i].second)
+                 group.spawn([&f, i]() { f(i); });
+               else
+                 f(i);
+             group.wait();
+           });
+}
+
+//for_each with several threads
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class F>
+void BST<Tk,Tv,Tc,Tb,Ta>::parallel_for_each(F f, std::size_t threads)
+{
+  const std::vector<std::pair<Node*,bool>> items = chunks(threads);
+  forChunks(items, threads, [&items, &f](std::size_t i)
+            {
+              if(items[i].second) visit(items[i].first, [&f](Node* n) { f(n->data); });
+              else f(items[i].first->data);
+            });
+}
+
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class F>
+void BST<Tk,Tv,Tc,Tb,Ta>::parallel_for_each(F f, std::size_t threads) const
+{
+  const std::vector<std::pair<Node*,bool>> items = chunks(threads);
+  forChunks(items, threads, [&items, &f](std::size_t i)
+            {
+              if(items[i].second) visit(items[i].first, [&f](const Node* n) { f(n->data); });
+              else f(static_cast<const pair&>(items[i].first->data));
+            });
+}
+
+//reduce with several threads, merging the partial results in order
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class T, class R, class M>
+T BST<Tk,Tv,Tc,Tb,Ta>::parallel_reduce(T init, R reduce, M transform, std::size_t threads) const
+{
+  const std::vector<std::pair<Node*,bool>> items = chunks(threads);
+  std::vector<T> partial(items.size(), init); //every chunk has at least one node, which overwrites its partial result
+  forChunks(items, threads, [&](std::size_t i)
+            {
+              const Node* first = items[i].first;
+              if(!items[i].second)
+              {
+                partial[i] = transform(static_cast<const pair&>(first->data));
+                return;
+              }
+              bool empty = true;
+              visit(items[i].first, [&](const Node* n)
+                    {
+                      if(empty) partial[i] = transform(static_cast<const pair&>(n->data));
+                      else partial[i] = reduce(std::move(partial[i]), transform(static_cast<const pair&>(n->data)));
+                      empty = false;
+                    });
+            });
+  for(auto& p: partial)
+    init = reduce(std::move(init), std::move(p));
+  return init;
+}
+
+//count_if with several threads
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class P>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::parallel_count_if(P pred, std::size_t threads) const
+{
+  return parallel_reduce(std::size_t(0), [](std::size_t a, std::size_t b) { return a+b; },
+                         [&pred](const pair& x) -> std::size_t { return pred(x) ? 1 : 0; }, threads);
+}
+
+//relink a sorted sequence of nodes as a balanced subtree (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+typename BST<Tk,Tv,Tc,Tb,Ta>::Node* BST<Tk,Tv,Tc,Tb,Ta>::relink(typename BST<Tk,Tv,Tc,Tb,Ta>::Node** nodes, std::size_t count, std::size_t depth, std::size_t bottom, typename BST<Tk,Tv,Tc,Tb,Ta>::Node* parent, task_group* group) noexcept
+{
+  if(count == 0) return nullptr;
+  std::size_t middle = (count-1)/2; //number of nodes on the left of the median
+  Node* n = nodes[middle];
+  n->left.release(); //the old children are relinked by their own call
+  n->right.release();
+  n->parent = parent;
+  recolour(n, depth == bottom, Tb{});
+  setSize(n, count, sized{}); //the children may still be relinked by other tasks
+  bool spawned = false;
+  if(group && middle > task_cutoff)
+    try
+    {
+      group->spawn([=]() { n->left.reset(relink(nodes, middle, depth+1, bottom, n, group)); });
+      spawned = true;
+    }
+    catch(...) {} //no memory for the task: the left half is relinked here
+  if(!spawned)
+    n->left.reset(relink(nodes, middle, depth+1, bottom, n, group));
+  n->right.reset(relink(nodes+middle+1, count-middle-1, depth+1, bottom, n, group));
+  return n;
+}
+
+//turn the tree into a vine (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::treeToVine() noexcept
+{
+  std::size_t count = 0;
+  Node* rest = root.get();
+  while(rest)
+  {
+    if(rest->left)
+    { //move the left child on the spine
+      Node* l = rest->left.get();
+      rotateRight(rest);
+      rest = l;
+    }
+    else
+    {
+      recolour(rest, false, Tb{});
+      ++count;
+      rest = rest->right.get();
+    }
+  }
+  return count;
+}
+
+//compress the right spine (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::compress(std::size_t count, const bool bottom) noexcept
+{
+  Node* scanner = root.get();
+  for(std::size_t i=0; i<count; ++i)
+  {
+    rotateLeft(scanner); //scanner becomes the left child of the next node on the spine
+    if(bottom) recolour(scanner, true, Tb{}); //red leaves of a red-black tree
+    scanner = scanner->parent->right.get();
+  }
+}
+
+//build a balanced subtree from a sorted sequence (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class It>
+std::unique_ptr<typename BST<Tk,Tv,Tc,Tb,Ta>::Node,typename BST<Tk,Tv,Tc,Tb,Ta>::Deleter>
+BST<Tk,Tv,Tc,Tb,Ta>::buildtree(It& first, std::size_t count, std::size_t depth, std::size_t bottom)
+{
+  if(count == 0) return nullptr;
+  std::size_t middle = (count-1)/2; //number of pairs on the left of the median
+  std::unique_ptr<Node,Deleter> left = buildtree(first, middle, depth+1, bottom);
+  std::unique_ptr<Node,Deleter> n{newNode(*first, nullptr)}; //the median
+  ++first;
+  recolour(n.get(), depth == bottom, Tb{});
+  setSize(n.get(), count, sized{});
+  n->left = std::move(left);
+  if(n->left) n->left->parent = n.get();
+  n->right = buildtree(first, count-middle-1, depth+1, bottom);
+  if(n->right) n->right->parent = n.get();
+  return n;
+}
+
+//replace the content of the tree with a sorted range (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class It>
+void BST<Tk,Tv,Tc,Tb,Ta>::assignSorted(It first, std::size_t count)
+{
+  root = buildtree(first, count, 0, bottomLevel(count));
+  threadTree(linked{});
+  findEnds();
+}
+
+//depth of the incomplete last level of a balanced tree (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+std::size_t BST<Tk,Tv,Tc,Tb,Ta>::bottomLevel(std::size_t count) noexcept
+{
+  std::size_t bottom = 0; //depth of the last level
+  while((std::size_t(2) << bottom) <= count) ++bottom;
+  if((std::size_t(2) << bottom) == count+1) ++bottom; //perfect tree: no red level
+  return bottom;
+}
+
+//replace the content of the tree with a single pass range (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class It>
+void BST<Tk,Tv,Tc,Tb,Ta>::assignRange(It first, It last, std::input_iterator_tag)
+{
+  std::vector<std::pair<Tk,Tv>> values(first, last); //buffer of the pairs
+  auto less = [this](const std::pair<Tk,Tv>& a, const std::pair<Tk,Tv>& b) { return comp(a.first, b.first); };
+  std::stable_sort(values.begin(), values.end(), less);
+  //keep the first pair of every group with the same key
+  auto unique = std::unique(values.begin(), values.end(),
+                            [&less](const std::pair<Tk,Tv>& a, const std::pair<Tk,Tv>& b) { return !less(a, b); });
+  values.erase(unique, values.end());
+  assignSorted(std::make_move_iterator(values.begin()), values.size());
+}
+
+//replace the content of the tree with a multi pass range (private)
+template <class Tk, class Tv, class Tc, class Tb, class Ta>
+template <class It>
+void BST<Tk,Tv,Tc,Tb,Ta>::assignRange(It first, It last, std::forward_iterator_tag)
+{
+  using value = typename std::iterator_traits<It>::value_type;
+  //are the keys strictly increasing?
+  It unsorted = std::adjacent_find(first, last,
+                                   [this](const value& a, const value& b) { return !comp(a.first, b.first); });
+  if(unsorted != last)
+    assignRange(first, last, std::input_iterator_tag{});
+  else
+    assignSorted(first, std::distance(first, last));
 }
 
 //print ordered list
-template<class Tk, class Tv, class Tc>
-std::ostream& BST<Tk,Tv,Tc>::printOrderedList(std::ostream& os) const
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::ostream& BST<Tk,Tv,Tc,Tb,Ta>::printOrderedList(std::ostream& os) const
 {
   Const_iterator start{cbegin()};
   Const_iterator stop{cend()};
@@ -514,15 +1617,15 @@ std::ostream& BST<Tk,Tv,Tc>::printOrderedList(std::ostream& os) const
 
 #ifdef PRINT
 //print node (private)
-template<class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::printNode(const std::unique_ptr<typename BST<Tk,Tv,Tc>::Node>& n, std::ostream& os) const noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::printNode(const std::unique_ptr<typename BST<Tk,Tv,Tc,Tb,Ta>::Node,typename BST<Tk,Tv,Tc,Tb,Ta>::Deleter>& n, std::ostream& os) const noexcept
 {
   os << "(" << n->data.first << ":" << n->data.second << ")";
 }
 
 //print the structure of the tree (private)
-template<class Tk, class Tv, class Tc>
-void BST<Tk,Tv,Tc>::printBST(const std::string& prefix, const std::unique_ptr<typename BST<Tk,Tv,Tc>::Node>& n, const bool nleft, std::ostream& os) const noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+void BST<Tk,Tv,Tc,Tb,Ta>::printBST(const std::string& prefix, const std::unique_ptr<typename BST<Tk,Tv,Tc,Tb,Ta>::Node,typename BST<Tk,Tv,Tc,Tb,Ta>::Deleter>& n, const bool nleft, std::ostream& os) const noexcept
 {
  if(n)
  {
@@ -536,8 +1639,8 @@ void BST<Tk,Tv,Tc>::printBST(const std::string& prefix, const std::unique_ptr<ty
 }
 
 //print Tree (public)
-template<class Tk, class Tv, class Tc>
-std::ostream& BST<Tk,Tv,Tc>::printTree(std::ostream& os) const noexcept
+template<class Tk, class Tv, class Tc, class Tb, class Ta>
+std::ostream& BST<Tk,Tv,Tc,Tb,Ta>::printTree(std::ostream& os) const noexcept
 {
  if(!root)
   {
@@ -8,15 +8,63 @@
 #define __NODE_
 
 #include<memory> //unique_ptr
-#include<utility> //pair
+#include<utility> //pair, piecewise_construct
+#include<tuple>
+#include<type_traits> //is_base_of
 
+/**
+ * \brief Empty base of the class node, used when the tree does not need
+ * to store any bookkeeping information in its nodes.
+ */
+struct no_meta {};
 
+/**
+ * \brief Base of the meta of the threaded policy: links to the previous and the next node in key order.
+ *
+ * The links point to the thread_links base of the nodes, which is converted back to the node with a static_cast.
+ */
+struct thread_links
+{
+  thread_links* prev = nullptr;
+  thread_links* next = nullptr;
+};
+
+/**
+ * \brief Trait telling if the nodes of type N are linked in key order.
+ */
 template<class N>
-struct node {
+using is_threaded = std::is_base_of<thread_links, N>;
+
+/**
+ * \brief Deleter of the nodes created with new.
+ */
+struct heap_delete
+{
+  template<class T>
+  void operator()(T* p) const noexcept { delete p; }
+};
+
+/**
+ * \brief Deleter of the nodes created by an allocator: it destroys the node,
+ * while its memory is given back to the allocator by the tree.
+ */
+struct destroy_delete
+{
+  template<class T>
+  void operator()(T* p) const noexcept { p->~T(); }
+};
+
+/**
+ * \tparam N Type of the data stored in the node.
+ * \tparam M Type of the extra data required by the balancing policy of the tree (e.g. the colour).
+ * \tparam D Type of the deleter of the children. Default is heap_delete.
+ */
+template<class N, class M = no_meta, class D = heap_delete>
+struct node : M {
 
   //BST has to use findSmallest()
-  template<class Tk, class Tv, class Tc> friend class BST;
-  //iterator has to use findSmallest() and findBigger()
+  template<class Tk, class Tv, class Tc, class Tb, class Ta> friend class BST;
+  //iterator has to use findSmallest(), findBigger() and their mirrors
   template<class O, class I> friend class iterator;
 
   /** Data contained in the node */
@@ -24,9 +72,9 @@ struct node {
   using value_type = N;
 
   /** Unique_ptr to the left child node*/
-  std::unique_ptr<node> left;
+  std::unique_ptr<node, D> left;
   /** Unique_ptr to the right child node*/
-  std::unique_ptr<node> right;
+  std::unique_ptr<node, D> right;
   /** Raw pointer to the parent node */
   node* parent = nullptr ;
 
@@ -53,6 +101,26 @@ struct node {
   node(const N& n, node* p)
 	 : data{n}, left{nullptr}, right{nullptr}, parent{p} {}
 
+  /**
+   * \brief Custom constructor for the class node.
+   * \param n Data to be moved in the new node.
+   * \param p Parent of the new node.
+   */
+  node(N&& n, node* p)
+	 : data{std::move(n)}, left{nullptr}, right{nullptr}, parent{p} {}
+
+  /**
+   * \brief Custom constructor for the class node.
+   * \param k Arguments of the constructor of the key.
+   * \param v Arguments of the constructor of the value.
+   * \param p Parent of the new node.
+   *
+   * The pair is built in place in the node, without any temporary pair.
+   */
+  template<class... K, class... V>
+  node(std::piecewise_construct_t, std::tuple<K...> k, std::tuple<V...> v, node* p)
+	 : data{std::piecewise_construct, std::move(k), std::move(v)}, left{nullptr}, right{nullptr}, parent{p} {}
+
   /**
    * \brief Copy constructor for the class node.
    * \param n Const reference to the node to be copied.
@@ -60,7 +128,7 @@ struct node {
    * This constructor creates a node copying the content of another node.
    */
   node(const node& n)
-   : data{n.data}, left{nullptr}, right{nullptr}, parent{n.parent} {}
+   : M{n}, data{n.data}, left{nullptr}, right{nullptr}, parent{n.parent} {}
 
   /**
    *\brief Default destructor for the class node.
@@ -68,34 +136,111 @@ struct node {
   ~node() noexcept = default;
 
   /**
-   * \brief Recursive function that returns the leftmost node of the tree having as root the current node.
+   * \brief Function that returns the leftmost node of the tree having as root the current node.
    * \return node* Pointer to the leftmost node.
+   *
+   * The function walks down the left children with a loop, so it does not use any stack
+   * even on degenerate trees.
    */
   node* findSmallest() noexcept
   {
-    if(left) return left->findSmallest();
-    return this;
-   }
+    node* n = this;
+    while(n->left) n = n->left.get();
+    return n;
+  }
 
   /**
-   * \brief Recursive function that returns the first right ancestor of the current node.
+   * \brief Function that returns the first right ancestor of the current node.
    * \return node* pointer to the first right ancestor of the current node, if any, nullptr otherwise.
    *
    * If the current node is the left child of its parent, it returns the parent of the current node.
-   * Otherwise it recursively search in the ancestors of the current node until a left child found.
+   * Otherwise it climbs the ancestors of the current node until a left child is found.
    */
   node* findBigger() const;
+
+  /**
+   * \brief Function that returns the rightmost node of the tree having as root the current node.
+   * \return node* Pointer to the rightmost node.
+   */
+  node* findLargest() noexcept
+  {
+    node* n = this;
+    while(n->right) n = n->right.get();
+    return n;
+  }
+
+  /**
+   * \brief Function that returns the first left ancestor of the current node.
+   * \return node* pointer to the first left ancestor of the current node, if any, nullptr otherwise.
+   *
+   * It is the mirror of findBigger: it climbs the ancestors of the current node until a right child is found.
+   */
+  node* findSmaller() const;
 };
 
+template<class N, class M, class D>
+node<N,M,D>* node<N,M,D>::findBigger() const
+{
+	const node* n = this;
+	while(n->parent && n->parent->right.get()==n) //if it is a right child we continue going up
+		n = n->parent;
+	return n->parent; //parent of a left child, or nullptr if we reached the root
+}
+
+template<class N, class M, class D>
+node<N,M,D>* node<N,M,D>::findSmaller() const
+{
+	const node* n = this;
+	while(n->parent && n->parent->left.get()==n) //if it is a left child we continue going up
+		n = n->parent;
+	return n->parent; //parent of a right child, or nullptr if we reached the root
+}
+
+/**
+ * \brief Handle owning a node which has been extracted from a tree.
+ * \tparam N Type of the node, allocated with new.
+ *
+ * The handle can only be moved: the node it owns is given back to a tree by BST::insert,
+ * which relinks it without allocating or copying the pair, or is deleted with the handle.
+ */
 template<class N>
-node<N>* node<N>::findBigger() const
+class node_handle
 {
-	if(parent)
+  template<class Tk, class Tv, class Tc, class Tb, class Ta> friend class BST;
 
-		if(parent->right.get()==this) //if it is a right child we continue going up
-		return parent->findBigger();
+  /** The extracted node, nullptr if the handle is empty */
+  std::unique_ptr<N, heap_delete> n;
 
-	return parent; //if it is a left child we return
-}
+  explicit node_handle(N* p) noexcept : n{p} {}
+
+  N* release() noexcept { return n.release(); }
+
+public:
+  using key_type = typename std::remove_const<typename N::value_type::first_type>::type;
+  using mapped_type = typename N::value_type::second_type;
+
+  /**
+   * \brief Default constructor, the handle is empty.
+   */
+  node_handle() noexcept = default;
+
+  node_handle(node_handle&&) noexcept = default;
+  node_handle& operator=(node_handle&&) noexcept = default;
+
+  /**
+   * \brief Function that returns true if the handle does not own a node.
+   */
+  bool empty() const noexcept { return !n; }
+  explicit operator bool() const noexcept { return bool(n); }
+
+  /**
+   * \brief Functions that give access to the pair of the node, the handle must not be empty.
+   *
+   * The key cannot be modified, since it is constant in the pair.
+   */
+  const key_type& key() const noexcept { return n->data.first; }
+  mapped_type& mapped() const noexcept { return n->data.second; }
+  typename N::value_type& value() const noexcept { return n->data; }
+};
 
 #endif
@@ -0,0 +1,368 @@
+/**
+ * \file persistent.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief Class implementing a persistent search tree, whose versions can be read by other threads while it is modified.
+ */
+
+#ifndef __PERSISTENT_
+#define __PERSISTENT_
+
+#include<memory> //shared_ptr, atomic_load
+#include<mutex>
+#include<utility> //pair
+#include<iostream>
+#include<iterator>
+#include<vector>
+#include<algorithm> //max
+#include<functional> //less
+
+/**
+ * \brief Persistent search tree: updates never modify a node, they copy the path from the root to the changed node.
+ * \tparam Tk Type of node keys.
+ * \tparam Tv Type of node values.
+ * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ *
+ * Every insert or erase builds a new version of the tree which shares all the nodes outside the copied path with the
+ * previous one, and publishes its root atomically. A snapshot is a handle to a version: it can be read and iterated
+ * by any thread without locks, and it is not affected by later updates. Nodes are owned through std::shared_ptr,
+ * so a node is freed when no version uses it anymore. The tree is kept balanced as an AVL tree, so that every update
+ * copies O(log n) nodes. Updates are serialized by a mutex.
+ */
+template<class Tk, class Tv, class Tc=std::less<Tk>>
+class PersistentBST
+{
+public:
+
+  using pair = std::pair<const Tk,Tv>;
+
+private:
+
+  struct pnode;
+  using link = std::shared_ptr<const pnode>;
+
+  /** Immutable node: its children and the sizes are fixed when it is built */
+  struct pnode
+  {
+    pair data;
+    link left;
+    link right;
+    /** Number of nodes in the subtree */
+    std::size_t size;
+    /** Height of the subtree */
+    int height;
+
+    pnode(const pair& x, link l, link r)
+    : data{x}, left{std::move(l)}, right{std::move(r)}, size{1+sizeOf(left)+sizeOf(right)},
+      height{1+std::max(heightOf(left), heightOf(right))} {}
+  };
+
+  /** Root of the current version, read and written with std::atomic_load and std::atomic_store */
+  link root;
+  /** Mutex serializing the updates */
+  std::mutex writerMutex;
+
+  static std::size_t sizeOf(const link& n) noexcept { return n ? n->size : 0; }
+  static int heightOf(const link& n) noexcept { return n ? n->height : 0; }
+
+  static link make(const pair& x, link l, link r)
+  { return std::make_shared<pnode>(x, std::move(l), std::move(r)); }
+
+  /**
+   * \brief Function that builds a node with key x and children l, r, whose heights differ at most by two,
+   * rotating it if they differ by two.
+   */
+  static link balance(const pair& x, link l, link r);
+
+  /**
+   * \brief Function that returns the copy of the subtree n with x inserted, or n itself if the key is already there.
+   */
+  link insertRec(const link& n, const pair& x);
+
+  /**
+   * \brief Function that returns the copy of the subtree n without the key x, or n itself if the key is not there.
+   */
+  link eraseRec(const link& n, const Tk& x);
+
+  /**
+   * \brief Function that returns the copy of the subtree n without its minimum, which is stored in m.
+   */
+  static link eraseMin(const link& n, const pnode*& m);
+
+public:
+
+  /**comparison operator */
+  Tc comp;
+
+  /**
+   * \brief Immutable version of the tree, it can be used by any thread while the tree is modified.
+   */
+  class snapshot
+  {
+    friend class PersistentBST;
+
+    link root;
+    Tc comp;
+
+    snapshot(link r, const Tc& c) : root{std::move(r)}, comp{c} {}
+
+  public:
+
+    /**
+     * \brief Forward iterator over the pairs of a snapshot, in ascending key order.
+     *
+     * Nodes have no parent pointer, since they are shared by several versions with different parents:
+     * the iterator keeps the path of the nodes whose right subtree is still to be visited.
+     * It is valid as long as the snapshot exists.
+     */
+    class Const_iterator
+    {
+      friend class snapshot;
+
+      std::vector<const pnode*> stack;
+
+      void pushLeft(const pnode* n)
+      {
+        for(; n; n = n->left.get())
+          stack.push_back(n);
+      }
+
+    public:
+
+      using value_type = const pair;
+      using reference = value_type&;
+      using pointer = value_type*;
+      using iterator_category = std::forward_iterator_tag;
+      using difference_type = std::ptrdiff_t;
+
+      Const_iterator() = default;
+
+      /**
+       * \brief Overload of the pre-increment operator ++.
+       */
+      Const_iterator& operator++()
+      {
+        const pnode* n = stack.back();
+        stack.pop_back();
+        pushLeft(n->right.get());
+        return *this;
+      }
+
+      /**
+       * \brief Overload of the post-increment operator ++.
+       */
+      Const_iterator operator++(int)
+      { Const_iterator tmp {*this};
+        ++(*this);
+        return tmp;
+      }
+
+      friend bool operator==(const Const_iterator& x, const Const_iterator& y) noexcept
+      { return x.stack.empty() ? y.stack.empty() : (!y.stack.empty() && x.stack.back() == y.stack.back()); }
+      friend bool operator!=(const Const_iterator& x, const Const_iterator& y) noexcept { return !(x==y); }
+
+      reference operator*() const noexcept { return stack.back()->data; }
+      pointer operator->() const noexcept { return &**this; }
+    };
+
+    using Iterator = Const_iterator;
+
+    /**
+     * \brief Default constructor: empty snapshot.
+     */
+    snapshot() = default;
+
+    /**
+     * \brief Function that returns the number of pairs of the snapshot.
+     */
+    std::size_t size() const noexcept { return sizeOf(root); }
+
+    Const_iterator begin() const
+    { Const_iterator it;
+      it.pushLeft(root.get());
+      return it;
+    }
+
+    Const_iterator end() const noexcept { return Const_iterator{}; }
+    Const_iterator cbegin() const { return begin(); }
+    Const_iterator cend() const noexcept { return end(); }
+
+    /**
+     * \brief This function finds a given key.
+     * \param x Key to be found.
+     * \return Const_iterator Iterator to the node with the key, end() if there is no such node.
+     */
+    Const_iterator find(const Tk& x) const
+    {
+      Const_iterator it;
+      for(const pnode* n = root.get(); n; )
+      {
+        if(comp(x, n->data.first))
+        {
+          it.stack.push_back(n); //its key comes after the ones on the left
+          n = n->left.get();
+        }
+        else if(comp(n->data.first, x))
+          n = n->right.get();
+        else
+        {
+          it.stack.push_back(n);
+          return it;
+        }
+      }
+      return end();
+    }
+
+    /**
+     * \brief Functions that prints the pairs in acending order.
+     */
+    std::ostream& printOrderedList(std::ostream& os) const
+    {
+      if(!root)
+        return os << "Empty tree" << std::endl;
+      for(const auto& x: *this)
+        os << x.first << ":" << x.second << "    ";
+      return os;
+    }
+
+    /**
+     * \brief Operator << to print the snapshot in ascending key order.
+     */
+    friend std::ostream& operator<<(std::ostream& os, const snapshot& s) { return s.printOrderedList(os); }
+  };
+
+  /**
+   * \brief Default constructor for the class PersistentBST.
+   */
+  PersistentBST() = default;
+
+  PersistentBST(const PersistentBST&) = delete;
+  PersistentBST& operator=(const PersistentBST&) = delete;
+
+  /**
+   * \brief Function that returns the current version of the tree, it can be called by any thread.
+   */
+  snapshot current() const { return snapshot{std::atomic_load_explicit(&root, std::memory_order_acquire), comp}; }
+
+  /**
+   * \brief This function inserts a new pair and publishes the new version.
+   * \param x Pair composed by a key and a value.
+   * \return bool True if the pair has been inserted, false if the key was already in the tree.
+   */
+  bool insert(const pair& x)
+  {
+    std::lock_guard<std::mutex> lock{writerMutex};
+    link r = std::atomic_load_explicit(&root, std::memory_order_relaxed);
+    link n = insertRec(r, x);
+    if(n == r) return false;
+    std::atomic_store_explicit(&root, std::move(n), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \brief This function erases a key and publishes the new version.
+   * \param x Key to be erased.
+   * \return bool True if the key has been erased, false if it was not in the tree.
+   */
+  bool erase(const Tk& x)
+  {
+    std::lock_guard<std::mutex> lock{writerMutex};
+    link r = std::atomic_load_explicit(&root, std::memory_order_relaxed);
+    link n = eraseRec(r, x);
+    if(n == r) return false;
+    std::atomic_store_explicit(&root, std::move(n), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * \brief Function that publishes an empty version, the nodes are freed when no snapshot uses them.
+   */
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock{writerMutex};
+    std::atomic_store_explicit(&root, link{}, std::memory_order_release);
+  }
+
+  /**
+   * \brief Function that returns the number of pairs of the current version.
+   */
+  std::size_t size() const { return current().size(); }
+
+  /**
+   * \brief Operator << to print the current version in ascending key order.
+   */
+  friend std::ostream& operator<<(std::ostream& os, const PersistentBST& tree) { return os << tree.current(); }
+};
+
+template<class Tk, class Tv, class Tc>
+typename PersistentBST<Tk,Tv,Tc>::link PersistentBST<Tk,Tv,Tc>::balance(const pair& x, link l, link r)
+{
+  int hl = heightOf(l), hr = heightOf(r);
+  if(hl > hr+1)
+  {
+    if(heightOf(l->left) >= heightOf(l->right)) //single rotation to the right
+      return make(l->data, l->left, make(x, l->right, std::move(r)));
+    const pnode& lr = *l->right; //double rotation
+    return make(lr.data, make(l->data, l->left, lr.left), make(x, lr.right, std::move(r)));
+  }
+  if(hr > hl+1)
+  {
+    if(heightOf(r->right) >= heightOf(r->left)) //single rotation to the left
+      return make(r->data, make(x, std::move(l), r->left), r->right);
+    const pnode& rl = *r->left; //double rotation
+    return make(rl.data, make(x, std::move(l), rl.left), make(r->data, rl.right, r->right));
+  }
+  return make(x, std::move(l), std::move(r));
+}
+
+template<class Tk, class Tv, class Tc>
+typename PersistentBST<Tk,Tv,Tc>::link PersistentBST<Tk,Tv,Tc>::insertRec(const link& n, const pair& x)
+{
+  if(!n)
+    return make(x, nullptr, nullptr);
+  if(comp(x.first, n->data.first))
+  {
+    link l = insertRec(n->left, x);
+    return l == n->left ? n : balance(n->data, std::move(l), n->right);
+  }
+  if(comp(n->data.first, x.first))
+  {
+    link r = insertRec(n->right, x);
+    return r == n->right ? n : balance(n->data, n->left, std::move(r));
+  }
+  return n;
+}
+
+template<class Tk, class Tv, class Tc>
+typename PersistentBST<Tk,Tv,Tc>::link PersistentBST<Tk,Tv,Tc>::eraseRec(const link& n, const Tk& x)
+{
+  if(!n)
+    return n;
+  if(comp(x, n->data.first))
+  {
+    link l = eraseRec(n->left, x);
+    return l == n->left ? n : balance(n->data, std::move(l), n->right);
+  }
+  if(comp(n->data.first, x))
+  {
+    link r = eraseRec(n->right, x);
+    return r == n->right ? n : balance(n->data, n->left, std::move(r));
+  }
+  if(!n->left) return n->right;
+  if(!n->right) return n->left;
+  const pnode* m; //the successor takes the place of the node
+  link r = eraseMin(n->right, m);
+  return balance(m->data, n->left, std::move(r));
+}
+
+template<class Tk, class Tv, class Tc>
+typename PersistentBST<Tk,Tv,Tc>::link PersistentBST<Tk,Tv,Tc>::eraseMin(const link& n, const pnode*& m)
+{
+  if(!n->left)
+  {
+    m = n.get();
+    return n->right;
+  }
+  return balance(n->data, eraseMin(n->left, m), n->right);
+}
+
+#endif
@@ -0,0 +1,260 @@
+/**
+ * \file pool.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the implementation of the node allocator node_pool.
+ */
+
+#ifndef __POOL_
+#define __POOL_
+
+#include<memory> //allocator
+#include<new> //operator new
+#include<cstddef> //size_t
+#include<type_traits>
+#include<utility> //swap
+
+#include"node.h"
+
+/**
+ * \brief Allocator handing out objects from contiguous chunks of memory.
+ * \tparam T Type of the allocated objects.
+ *
+ * Memory is requested to the system in chunks of geometrically increasing size (up to
+ * max_chunk objects), and freed objects are recycled through a free list.
+ * The whole pool is given back to the system by release(), in a time proportional
+ * to the number of chunks.
+ * A pool owns its memory, so copies of a pool are new empty pools, and two pools compare
+ * equal only if they are the same object.
+ */
+template<class T>
+class node_pool
+{
+  template<class U> friend class node_pool;
+
+  /** Slot of a chunk: either a free slot, linked in the free list, or an object. */
+  union slot
+  {
+    slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  /** Header of a chunk, chunks are linked in a list. */
+  struct chunk
+  {
+    chunk* next;
+    std::size_t size;
+  };
+
+  /** Offset of the first slot from the beginning of a chunk. */
+  static constexpr std::size_t header = (sizeof(chunk) + alignof(slot) - 1) / alignof(slot) * alignof(slot);
+
+  /** Number of slots of the first chunk. */
+  static constexpr std::size_t min_chunk = 32;
+
+  /** Maximum number of slots of a chunk. */
+  static constexpr std::size_t max_chunk = 65536;
+
+  /** List of the chunks, the most recent first. */
+  chunk* chunks = nullptr;
+  /** First free slot that has been recycled. */
+  slot* free = nullptr;
+  /** First never used slot of the most recent chunk. */
+  slot* next = nullptr;
+  /** One past the last slot of the most recent chunk. */
+  slot* last = nullptr;
+  /** Number of single objects currently allocated. */
+  std::size_t used = 0;
+
+  /**
+   * \brief Function that requests a new chunk to the system.
+   * \param min_size Minimum number of slots of the new chunk.
+   */
+  void grow(std::size_t min_size = 0)
+  {
+    std::size_t size = min_chunk;
+    if(chunks) size = 2*chunks->size;
+    if(size > max_chunk) size = max_chunk;
+    if(size < min_size) size = min_size;
+    chunk* c = static_cast<chunk*>(::operator new(header + size*sizeof(slot)));
+    c->next = chunks;
+    c->size = size;
+    chunks = c;
+    next = reinterpret_cast<slot*>(reinterpret_cast<unsigned char*>(c) + header);
+    last = next + size;
+  }
+
+public:
+
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  /**
+   * \brief Default constructor for the class node_pool, it creates an empty pool.
+   */
+  node_pool() noexcept = default;
+
+  /**
+   * \brief Copy constructor: a pool cannot share its chunks, so it creates an empty pool.
+   */
+  node_pool(const node_pool&) noexcept {}
+
+  /**
+   * \brief Rebinding constructor: it creates an empty pool for objects of type T.
+   */
+  template<class U>
+  node_pool(const node_pool<U>&) noexcept {}
+
+  /**
+   * \brief Move constructor: the chunks of the input pool are moved in the new one.
+   */
+  node_pool(node_pool&& p) noexcept
+  : chunks{p.chunks}, free{p.free}, next{p.next}, last{p.last}, used{p.used}
+  { p.chunks = nullptr; p.free = p.next = p.last = nullptr; p.used = 0; }
+
+  /**
+   * \brief Copy assignment: it leaves the pool unchanged, since chunks cannot be shared.
+   */
+  node_pool& operator=(const node_pool&) noexcept { return *this; }
+
+  /**
+   * \brief Move assignment: the current chunks are released and the ones of the input pool are taken.
+   */
+  node_pool& operator=(node_pool&& p) noexcept
+  {
+    node_pool tmp{std::move(p)};
+    swap(tmp);
+    return *this;
+  }
+
+  /**
+   * \brief Destructor for the class node_pool, it releases all the chunks.
+   */
+  ~node_pool() noexcept { release(); }
+
+  /**
+   * \brief Function that exchanges the chunks of two pools.
+   */
+  void swap(node_pool& p) noexcept
+  {
+    std::swap(chunks, p.chunks);
+    std::swap(free, p.free);
+    std::swap(next, p.next);
+    std::swap(last, p.last);
+    std::swap(used, p.used);
+  }
+
+  /**
+   * \brief Function that returns the number of single objects currently allocated by the pool.
+   */
+  std::size_t size() const noexcept { return used; }
+
+  /**
+   * \brief Function that allocates memory for n objects of type T.
+   * \param n Number of objects.
+   * \return T* Pointer to uninitialized memory.
+   *
+   * Single objects are taken from the free list or from the current chunk,
+   * arrays are requested directly to the system.
+   */
+  T* allocate(std::size_t n)
+  {
+    if(n != 1) return static_cast<T*>(::operator new(n*sizeof(T)));
+    slot* s;
+    if(free)
+    {
+      s = free;
+      free = free->next;
+    }
+    else
+    {
+      if(next == last) grow();
+      s = next++;
+    }
+    ++used;
+    return reinterpret_cast<T*>(s);
+  }
+
+  /**
+   * \brief Function that makes sure that the next n single allocations are contiguous.
+   * \param n Number of objects.
+   *
+   * If the free list is empty and the current chunk has not enough room, a chunk with at least
+   * n slots is requested to the system. The objects are then handed out in increasing addresses.
+   */
+  void reserve(std::size_t n)
+  {
+    if(free || std::size_t(last - next) >= n) return;
+    grow(n);
+  }
+
+  /**
+   * \brief Function that gives back memory obtained by allocate.
+   * \param p Pointer to the memory.
+   * \param n Number of objects.
+   *
+   * Single objects are pushed on the free list, their memory is given back to the system by release().
+   */
+  void deallocate(T* p, std::size_t n) noexcept
+  {
+    if(n != 1) { ::operator delete(p); return; }
+    slot* s = reinterpret_cast<slot*>(p);
+    s->next = free;
+    free = s;
+    --used;
+  }
+
+  /**
+   * \brief Function that gives back all the chunks to the system.
+   *
+   * All the objects allocated by the pool must have been destroyed (or must be trivially destructible).
+   */
+  void release() noexcept
+  {
+    while(chunks)
+    {
+      chunk* c = chunks;
+      chunks = c->next;
+      ::operator delete(c);
+    }
+    free = next = last = nullptr;
+    used = 0;
+  }
+
+  /**
+   * \brief Overload of the operator ==.
+   * \return bool True if and only if the two pools are the same object.
+   */
+  friend bool operator==(const node_pool& x, const node_pool& y) noexcept { return &x == &y; }
+
+  /**
+   * \brief Overload of the operator !=.
+   * \return bool True if and only if the two pools are different objects.
+   */
+  friend bool operator!=(const node_pool& x, const node_pool& y) noexcept { return &x != &y; }
+};
+
+/**
+ * \brief Trait telling if an allocator can release all its memory at once with release().
+ */
+template<class A>
+struct is_arena : std::false_type {};
+
+template<class T>
+struct is_arena<node_pool<T>> : std::true_type {};
+
+/**
+ * \brief Trait selecting the deleter used by the unique_ptr of the nodes.
+ *
+ * Nodes allocated by std::allocator are created with new and deleted by the unique_ptr,
+ * nodes allocated by any other allocator are only destroyed by the unique_ptr, and their
+ * memory is given back to the allocator by the tree.
+ */
+template<class A>
+struct node_deleter { using type = destroy_delete; };
+
+template<class T>
+struct node_deleter<std::allocator<T>> { using type = heap_delete; };
+
+#endif
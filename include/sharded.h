@@ -0,0 +1,422 @@
+/**
+ * \file sharded.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief Class implementing a map which partitions the keys among several BST, each with its own lock.
+ */
+
+#ifndef __SHARDED_
+#define __SHARDED_
+
+#include<array>
+#include<vector>
+#include<mutex>
+#include<shared_mutex> //shared_timed_mutex
+#include<atomic>
+#include<thread>
+#include<algorithm> //upper_bound, sort
+#include<iterator>
+#include<utility> //pair
+#include<iostream>
+#include<functional> //less
+
+#include"BST.h"
+
+/**
+ * \brief Map whose keys are partitioned by ranges among Shards red-black trees, so that threads working on different
+ * ranges do not wait for each other.
+ * \tparam Tk Type of node keys.
+ * \tparam Tv Type of node values.
+ * \tparam Tc Type of the comparison operator. Default is std::less<Tk>.
+ * \tparam Shards Number of trees.
+ *
+ * Every tree (shard) has its own mutex and its own node_pool. The shard i holds the keys between the split points i-1
+ * (included) and i (excluded), which are chosen from a sample of the keys by the range constructor and recomputed
+ * by resplit, online, when a shard holds more than twice its share of the keys.
+ * The split points are protected by a shared mutex: every operation reads them under a shared lock, resplit changes
+ * them under an exclusive lock.
+ */
+template<class Tk, class Tv, class Tc=std::less<Tk>, std::size_t Shards=16>
+class ShardedBST
+{
+public:
+
+  using pair = std::pair<const Tk,Tv>;
+  using tree_type = BST<Tk,Tv,Tc,red_black,node_pool<pair>>;
+
+  /** Minimum number of keys of a shard before it is considered too big */
+  static constexpr std::size_t min_resplit = 1024;
+
+private:
+
+  static_assert(Shards > 0, "ShardedBST needs at least one shard");
+
+  /** A tree, its lock and its number of keys */
+  struct shard
+  {
+    mutable std::mutex lock;
+    tree_type tree;
+    std::size_t count = 0;
+  };
+
+  std::array<shard,Shards> shards;
+  /** Shards-1 split points in ascending order, empty before the first split (all the keys are in the first shard) */
+  std::vector<Tk> splits;
+  mutable std::shared_timed_mutex splitLock;
+  /** Number of keys of all the shards */
+  std::atomic<std::size_t> total{0};
+
+  /**
+   * \brief Function that returns the shard of a key, with the split points locked.
+   */
+  std::size_t shardOf(const Tk& x) const
+  { return std::upper_bound(splits.begin(), splits.end(), x, comp) - splits.begin(); }
+
+  /**
+   * \brief Function that tells if a shard with count keys is too big, with respect to the keys of all the shards.
+   */
+  bool oversized(const std::size_t count) const noexcept
+  { return count > min_resplit && count > 2*total.load(std::memory_order_relaxed)/Shards; }
+
+  /**
+   * \brief Function that redistributes the keys among the shards, with the split points locked exclusively.
+   */
+  void resplitLocked();
+
+  /**
+   * \brief Function that calls f(i) for every shard i, from a pool of threads.
+   */
+  template<class F>
+  static void forShards(F f);
+
+public:
+
+  /**comparison operator */
+  Tc comp;
+
+  /**
+   * \brief Default constructor for the class ShardedBST.
+   * \param cmp Comparison operator.
+   */
+  explicit ShardedBST(Tc cmp=Tc{}) : comp{cmp}
+  {
+    for(auto& s: shards)
+      s.tree.comp = cmp;
+  }
+
+  /**
+   * \brief Constructor of the map from a range of pairs, the split points are chosen from a sample of the keys.
+   * \param first Beginning of the range.
+   * \param last End of the range.
+   * \param cmp Comparison operator.
+   *
+   * If a key appears more than once the first pair with that key is kept.
+   */
+  template<class It, class = typename std::iterator_traits<It>::iterator_category>
+  ShardedBST(It first, It last, Tc cmp=Tc{});
+
+  ShardedBST(const ShardedBST&) = delete;
+  ShardedBST& operator=(const ShardedBST&) = delete;
+
+  /**
+   * \brief This function inserts a new pair, it can be called by many threads.
+   * \param x Pair composed by a key and a value.
+   * \return bool True if the pair has been inserted, false if the key was already in the map.
+   *
+   * If the shard of the key becomes too big the map is resplit.
+   */
+  bool insert(const pair& x);
+
+  /**
+   * \brief This function erases a key, it can be called by many threads.
+   * \param x Key to be erased.
+   * \return bool True if the key has been erased, false if it was not in the map.
+   */
+  bool erase(const Tk& x);
+
+  /**
+   * \brief This function finds a key, it can be called by many threads.
+   * \param x Key to be found.
+   * \param value Set to a copy of the value associated with x, if any.
+   * \return bool True if the key is in the map.
+   */
+  bool find(const Tk& x, Tv& value) const;
+
+  /**
+   * \brief This function tells if a key is in the map, it can be called by many threads.
+   */
+  bool contains(const Tk& x) const;
+
+  /**
+   * \brief Function that returns the number of pairs of the map.
+   */
+  std::size_t size() const noexcept { return total.load(); }
+
+  /**
+   * \brief Function that balances all the shards, in parallel.
+   */
+  void Balance();
+
+  /**
+   * \brief Function that chooses new split points, so that all the shards have the same number of keys, and moves
+   * the keys to their new shard. Other threads wait until it has finished.
+   */
+  void resplit()
+  {
+    std::unique_lock<std::shared_timed_mutex> table{splitLock};
+    resplitLocked();
+  }
+
+  /**
+   * \brief Function that deletes all the pairs, the split points are kept.
+   */
+  void clear();
+
+  /**
+   * \brief Forward iterator visiting the shards one after the other, so the pairs are visited in ascending key order.
+   *
+   * No thread may modify the map while it is iterated.
+   */
+  class Const_iterator
+  {
+    friend class ShardedBST;
+
+    using tree_iterator = typename tree_type::Const_iterator;
+
+    const ShardedBST* map = nullptr;
+    std::size_t index = Shards;
+    tree_iterator it;
+
+    /** Function that moves the iterator to the first pair of the next non empty shard, if the current one is over */
+    void skip()
+    {
+      while(index < Shards && it == map->shards[index].tree.cend())
+        if(++index < Shards)
+          it = map->shards[index].tree.cbegin();
+    }
+
+    Const_iterator(const ShardedBST* m, const std::size_t i) : map{m}, index{i}
+    {
+      if(index < Shards)
+      {
+        it = map->shards[index].tree.cbegin();
+        skip();
+      }
+    }
+
+  public:
+
+    using value_type = typename std::iterator_traits<tree_iterator>::value_type;
+    using reference = typename std::iterator_traits<tree_iterator>::reference;
+    using pointer = typename std::iterator_traits<tree_iterator>::pointer;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+
+    Const_iterator() = default;
+
+    /**
+     * \brief Overload of the pre-increment operator ++.
+     */
+    Const_iterator& operator++()
+    {
+      ++it;
+      skip();
+      return *this;
+    }
+
+    /**
+     * \brief Overload of the post-increment operator ++.
+     */
+    Const_iterator operator++(int)
+    { Const_iterator tmp {*this};
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const Const_iterator& x, const Const_iterator& y)
+    { return x.index == y.index && (x.index == Shards || x.it == y.it); }
+    friend bool operator!=(const Const_iterator& x, const Const_iterator& y) { return !(x==y); }
+
+    reference operator*() const { return *it; }
+    pointer operator->() const { return &*it; }
+  };
+
+  using Iterator = Const_iterator;
+
+  Const_iterator begin() const { return Const_iterator{this, 0}; }
+  Const_iterator end() const { return Const_iterator{this, Shards}; }
+  Const_iterator cbegin() const { return begin(); }
+  Const_iterator cend() const { return end(); }
+
+  /**
+   * \brief Functions that prints the pairs in acending order, no thread may modify the map meanwhile.
+   */
+  std::ostream& printOrderedList(std::ostream& os) const
+  {
+    if(begin() == end())
+      return os << "Empty tree" << std::endl;
+    for(const auto& x: *this)
+      os << x.first << ":" << x.second << "    ";
+    return os;
+  }
+
+  /**
+   * \brief Operator << to print the map in ascending key order.
+   */
+  friend std::ostream& operator<<(std::ostream& os, const ShardedBST& map) { return map.printOrderedList(os); }
+};
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+template<class It, class>
+ShardedBST<Tk,Tv,Tc,Shards>::ShardedBST(It first, It last, Tc cmp) : ShardedBST{cmp}
+{
+  std::vector<std::pair<Tk,Tv>> values(first, last);
+  //the split points are the quantiles of a sample of at most 64 keys per shard
+  std::size_t step = values.size()/(64*Shards) + 1;
+  std::vector<Tk> sample;
+  for(std::size_t i=0; i<values.size(); i+=step)
+    sample.push_back(values[i].first);
+  std::sort(sample.begin(), sample.end(), comp);
+  if(!sample.empty())
+    for(std::size_t i=1; i<Shards; ++i)
+      splits.push_back(sample[i*sample.size()/Shards]);
+  std::array<std::vector<std::pair<Tk,Tv>>,Shards> buckets;
+  for(auto& x: values)
+    buckets[shardOf(x.first)].push_back(std::move(x));
+  forShards([this, &buckets](std::size_t i)
+            {
+              shard& s = shards[i];
+              s.tree.assign(std::make_move_iterator(buckets[i].begin()), std::make_move_iterator(buckets[i].end()));
+              for(auto it=s.tree.cbegin(); it!=s.tree.cend(); ++it)
+                ++s.count;
+              total += s.count;
+            });
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+bool ShardedBST<Tk,Tv,Tc,Shards>::insert(const pair& x)
+{
+  std::size_t count;
+  {
+    std::shared_lock<std::shared_timed_mutex> table{splitLock};
+    shard& s = shards[shardOf(x.first)];
+    std::lock_guard<std::mutex> lock{s.lock};
+    if(!s.tree.insert(x).second) return false;
+    count = ++s.count;
+    ++total;
+  }
+  if(oversized(count))
+  {
+    std::unique_lock<std::shared_timed_mutex> table{splitLock};
+    //another thread may have resplit the map meanwhile
+    if(std::any_of(shards.begin(), shards.end(), [this](const shard& s) { return oversized(s.count); }))
+      resplitLocked();
+  }
+  return true;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+bool ShardedBST<Tk,Tv,Tc,Shards>::erase(const Tk& x)
+{
+  std::shared_lock<std::shared_timed_mutex> table{splitLock};
+  shard& s = shards[shardOf(x)];
+  std::lock_guard<std::mutex> lock{s.lock};
+  if(s.tree.find(x) == s.tree.end()) return false;
+  s.tree.erase(x);
+  --s.count;
+  --total;
+  return true;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+bool ShardedBST<Tk,Tv,Tc,Shards>::find(const Tk& x, Tv& value) const
+{
+  std::shared_lock<std::shared_timed_mutex> table{splitLock};
+  const shard& s = shards[shardOf(x)];
+  std::lock_guard<std::mutex> lock{s.lock};
+  auto it = s.tree.find(x);
+  if(it == s.tree.end()) return false;
+  value = it->second;
+  return true;
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+bool ShardedBST<Tk,Tv,Tc,Shards>::contains(const Tk& x) const
+{
+  std::shared_lock<std::shared_timed_mutex> table{splitLock};
+  const shard& s = shards[shardOf(x)];
+  std::lock_guard<std::mutex> lock{s.lock};
+  return s.tree.find(x) != s.tree.end();
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+void ShardedBST<Tk,Tv,Tc,Shards>::Balance()
+{
+  std::shared_lock<std::shared_timed_mutex> table{splitLock};
+  forShards([this](std::size_t i)
+            {
+              std::lock_guard<std::mutex> lock{shards[i].lock};
+              shards[i].tree.Balance();
+            });
+}
+
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+void ShardedBST<Tk,Tv,Tc,Shards>::clear()
+{
+  std::unique_lock<std::shared_timed_mutex> table{splitLock};
+  for(auto& s: shards)
+  {
+    s.tree.clear();
+    s.count = 0;
+  }
+  total = 0;
+}
+
+//redistribute the keys among the shards (private)
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+void ShardedBST<Tk,Tv,Tc,Shards>::resplitLocked()
+{
+  //the shards are concatenated in ascending key order
+  std::vector<std::pair<Tk,Tv>> values;
+  values.reserve(total.load());
+  for(auto& s: shards)
+  {
+    for(auto& x: s.tree)
+      values.emplace_back(x.first, std::move(x.second));
+    s.tree.clear();
+  }
+  std::size_t n = values.size();
+  splits.clear();
+  if(n)
+    for(std::size_t i=1; i<Shards; ++i)
+      splits.push_back(values[i*n/Shards].first);
+  //the shards are rebuilt from sorted ranges, in linear time
+  forShards([this, &values, n](std::size_t i)
+            {
+              auto first = std::make_move_iterator(values.begin() + i*n/Shards);
+              auto last = std::make_move_iterator(values.begin() + (i+1)*n/Shards);
+              shards[i].tree.assign(first, last);
+              shards[i].count = last - first;
+            });
+}
+
+//call f for every shard from a pool of threads (private)
+template<class Tk, class Tv, class Tc, std::size_t Shards>
+template<class F>
+void ShardedBST<Tk,Tv,Tc,Shards>::forShards(F f)
+{
+  std::size_t threads = std::min<std::size_t>(Shards, std::max(1u, std::thread::hardware_concurrency()));
+  std::atomic<std::size_t> next{0};
+  auto work = [&next, &f]()
+              {
+                for(std::size_t i; (i = next++) < Shards; )
+                  f(i);
+              };
+  std::vector<std::thread> pool;
+  for(std::size_t t=1; t<threads; ++t)
+    pool.emplace_back(work);
+  work();
+  for(auto& t: pool)
+    t.join();
+}
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * \file simd.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the vectorized search of sorted arrays of arithmetic keys.
+ */
+
+#ifndef __SIMD_
+#define __SIMD_
+
+#include<cstddef> //size_t
+#include<cstdint>
+#include<functional> //less
+#include<type_traits>
+
+#if defined(__AVX2__)
+#include<immintrin.h>
+#elif defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+/**
+ * \brief Trait telling if keys of type T compared by C can be searched with simd_count.
+ *
+ * It is true when C is std::less of a 32 or 64 bit integer, of float or of double.
+ */
+template<class T, class C>
+struct has_simd_search
+: std::integral_constant<bool, std::is_same<C, std::less<T>>::value &&
+                               ((std::is_integral<T>::value && std::is_signed<T>::value &&
+                                 (sizeof(T) == 4 || sizeof(T) == 8)) ||
+                                std::is_same<T, float>::value || std::is_same<T, double>::value)> {};
+
+/**
+ * \brief Scalar version of simd_count, used for the last keys and when no vector instructions are available.
+ */
+template<class T>
+inline std::size_t scalar_count(const T* keys, std::size_t n, const T x) noexcept
+{
+  std::size_t c = 0; //counting instead of stopping, so that there are no branches depending on the keys
+  for(std::size_t i=0; i<n; ++i)
+    c += !(x < keys[i]);
+  return c;
+}
+
+/**
+ * \brief Functions that compare x with the first keys of an array, a vector register at a time.
+ *
+ * The comparison masks (-1 for the keys greater than x) are subtracted from an accumulator, so that there is no
+ * branch depending on the keys. They set i to the number of compared keys (a multiple of the register width)
+ * and return how many of them are greater than x.
+ */
+namespace simd_detail
+{
+#if defined(__AVX2__)
+  inline std::size_t sum32(__m256i acc) noexcept
+  {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return static_cast<std::size_t>(_mm_cvtsi128_si32(s));
+  }
+
+  inline std::size_t sum64(__m256i acc) noexcept
+  {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    return static_cast<std::size_t>(_mm_cvtsi128_si64(s));
+  }
+
+  inline std::size_t greater(const std::int32_t* keys, std::size_t& i, std::size_t n, const std::int32_t x) noexcept
+  {
+    const __m256i v = _mm256_set1_epi32(x);
+    __m256i acc = _mm256_setzero_si256();
+    for(i=0; i+8<=n; i+=8)
+      acc = _mm256_sub_epi32(acc, _mm256_cmpgt_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys+i)), v));
+    return sum32(acc);
+  }
+
+  inline std::size_t greater(const std::int64_t* keys, std::size_t& i, std::size_t n, const std::int64_t x) noexcept
+  {
+    const __m256i v = _mm256_set1_epi64x(x);
+    __m256i acc = _mm256_setzero_si256();
+    for(i=0; i+4<=n; i+=4)
+      acc = _mm256_sub_epi64(acc, _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys+i)), v));
+    return sum64(acc);
+  }
+
+  inline std::size_t greater(const float* keys, std::size_t& i, std::size_t n, const float x) noexcept
+  {
+    const __m256 v = _mm256_set1_ps(x);
+    __m256i acc = _mm256_setzero_si256();
+    for(i=0; i+8<=n; i+=8)
+      acc = _mm256_sub_epi32(acc, _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(keys+i), v, _CMP_GT_OQ)));
+    return sum32(acc);
+  }
+
+  inline std::size_t greater(const double* keys, std::size_t& i, std::size_t n, const double x) noexcept
+  {
+    const __m256d v = _mm256_set1_pd(x);
+    __m256i acc = _mm256_setzero_si256();
+    for(i=0; i+4<=n; i+=4)
+      acc = _mm256_sub_epi64(acc, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(keys+i), v, _CMP_GT_OQ)));
+    return sum64(acc);
+  }
+#elif defined(__SSE2__)
+  inline std::size_t sum32(__m128i s) noexcept
+  {
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return static_cast<std::size_t>(_mm_cvtsi128_si32(s));
+  }
+
+  inline std::size_t sum64(__m128i s) noexcept
+  {
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    return static_cast<std::size_t>(_mm_cvtsi128_si64(s));
+  }
+
+  inline std::size_t greater(const std::int32_t* keys, std::size_t& i, std::size_t n, const std::int32_t x) noexcept
+  {
+    const __m128i v = _mm_set1_epi32(x);
+    __m128i acc = _mm_setzero_si128();
+    for(i=0; i+4<=n; i+=4)
+      acc = _mm_sub_epi32(acc, _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys+i)), v));
+    return sum32(acc);
+  }
+
+  //SSE2 has no 64 bit integer comparison
+  inline std::size_t greater(const std::int64_t*, std::size_t& i, std::size_t, const std::int64_t) noexcept
+  { i = 0; return 0; }
+
+  inline std::size_t greater(const float* keys, std::size_t& i, std::size_t n, const float x) noexcept
+  {
+    const __m128 v = _mm_set1_ps(x);
+    __m128i acc = _mm_setzero_si128();
+    for(i=0; i+4<=n; i+=4)
+      acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(keys+i), v)));
+    return sum32(acc);
+  }
+
+  inline std::size_t greater(const double* keys, std::size_t& i, std::size_t n, const double x) noexcept
+  {
+    const __m128d v = _mm_set1_pd(x);
+    __m128i acc = _mm_setzero_si128();
+    for(i=0; i+2<=n; i+=2)
+      acc = _mm_sub_epi64(acc, _mm_castpd_si128(_mm_cmpgt_pd(_mm_loadu_pd(keys+i), v)));
+    return sum64(acc);
+  }
+#else
+  template<class T>
+  inline std::size_t greater(const T*, std::size_t& i, std::size_t, const T) noexcept
+  { i = 0; return 0; }
+#endif
+
+  /** Fixed width integer type with the same size of T, used to pick the overload of greater */
+  template<class T, bool = std::is_integral<T>::value>
+  struct lane { using type = T; };
+
+  template<class T>
+  struct lane<T, true> { using type = typename std::conditional<sizeof(T) == 4, std::int32_t, std::int64_t>::type; };
+}
+
+/**
+ * \brief Function that counts the keys of a sorted array which are not greater than x.
+ * \tparam T Arithmetic type, see has_simd_search.
+ * \param keys Array of keys.
+ * \param n Number of keys.
+ * \param x Key to be searched.
+ * \return std::size_t Number of keys k such that !(x < k), that is the position of the first key greater than x.
+ *
+ * All the keys are compared with x, several at a time with AVX2 (if the code is compiled with -mavx2) or SSE2,
+ * and without branches depending on the keys: for the short arrays of the nodes of a B+ tree this is faster than
+ * stopping at the first greater key, which costs a mispredicted branch.
+ */
+template<class T>
+inline std::size_t simd_count(const T* keys, std::size_t n, const T x) noexcept
+{
+  using L = typename simd_detail::lane<T>::type;
+  std::size_t i;
+  std::size_t greater = simd_detail::greater(reinterpret_cast<const L*>(keys), i, n, static_cast<L>(x));
+  return i - greater + scalar_count(keys+i, n-i, x);
+}
+
+#endif
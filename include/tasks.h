@@ -0,0 +1,266 @@
+/**
+ * \file tasks.h
+ * \authors Giovanni Pinna, Milton Plasencia, Gaia Saveri
+ * \brief header containing the work-stealing pool of threads used by the parallel algorithms of BST.
+ */
+
+#ifndef __TASKS_
+#define __TASKS_
+
+#include<vector>
+#include<deque>
+#include<memory> //unique_ptr
+#include<functional> //function
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<exception> //exception_ptr
+
+/**
+ * \brief Pool of threads running tasks with work stealing.
+ *
+ * Every thread has its own deque of tasks: it pushes and pops the tasks it spawns at the back, so that it works
+ * depth first on the most recent (and smallest) task, while idle threads steal the oldest (and biggest) tasks
+ * from the front of the deques of the others. The thread which calls run is the thread 0 of the pool, and it works
+ * with the others until its task has finished.
+ */
+class task_pool
+{
+  using task = std::function<void()>;
+
+  struct queue
+  {
+    std::mutex lock;
+    std::deque<task> tasks;
+  };
+
+  std::vector<std::unique_ptr<queue>> queues;
+  std::vector<std::thread> workers;
+  /** Number of tasks in all the deques */
+  std::atomic<std::size_t> queued{0};
+  std::atomic<bool> stop{false};
+  std::mutex sleepLock;
+  std::condition_variable wake;
+
+  /** Pool and index of the current thread, if it belongs to a pool */
+  static task_pool*& currentPool() noexcept
+  {
+    static thread_local task_pool* pool = nullptr;
+    return pool;
+  }
+
+  static std::size_t& currentIndex() noexcept
+  {
+    static thread_local std::size_t index = 0;
+    return index;
+  }
+
+  void work(std::size_t index)
+  {
+    currentPool() = this;
+    currentIndex() = index;
+    while(!stop.load())
+      if(!runOne())
+      {
+        std::unique_lock<std::mutex> lock{sleepLock};
+        wake.wait(lock, [this]() { return queued.load() > 0 || stop.load(); });
+      }
+  }
+
+public:
+
+  /**
+   * \brief Constructor of a pool with the given number of threads, including the one that calls run.
+   */
+  explicit task_pool(std::size_t threads)
+  {
+    if(threads == 0) threads = 1;
+    for(std::size_t i=0; i<threads; ++i)
+      queues.emplace_back(new queue);
+    for(std::size_t i=1; i<threads; ++i)
+      workers.emplace_back([this, i]() { work(i); });
+  }
+
+  task_pool(const task_pool&) = delete;
+  task_pool& operator=(const task_pool&) = delete;
+
+  /**
+   * \brief Function that returns the number of threads of the pool.
+   */
+  std::size_t size() const noexcept { return queues.size(); }
+
+  /**
+   * \brief Function that runs a task in the current thread, which becomes the thread 0 of the pool meanwhile.
+   * \param f Task, it can spawn other tasks with a task_group.
+   */
+  template<class F>
+  void run(F&& f)
+  {
+    task_pool* previous = currentPool();
+    std::size_t index = currentIndex();
+    currentPool() = this;
+    currentIndex() = 0;
+    try
+    {
+      f();
+    }
+    catch(...)
+    {
+      currentPool() = previous;
+      currentIndex() = index;
+      throw;
+    }
+    currentPool() = previous;
+    currentIndex() = index;
+  }
+
+  /**
+   * \brief Function that pushes a task in the deque of the current thread.
+   */
+  void push(task t)
+  {
+    queue& q = *queues[currentPool() == this ? currentIndex() : 0];
+    ++queued; //before the task can be stolen, so that the counter never goes below zero
+    try
+    {
+      std::lock_guard<std::mutex> lock{q.lock};
+      q.tasks.push_back(std::move(t));
+    }
+    catch(...)
+    {
+      --queued;
+      throw;
+    }
+    if(!workers.empty())
+    {
+      std::lock_guard<std::mutex> lock{sleepLock}; //a worker cannot miss the notification between its check and its wait
+      wake.notify_one();
+    }
+  }
+
+  /**
+   * \brief Function that runs a task, taken from the back of the deque of the current thread or stolen from the front
+   * of another deque.
+   * \return bool False if there were no tasks.
+   */
+  bool runOne()
+  {
+    std::size_t self = currentPool() == this ? currentIndex() : 0;
+    for(std::size_t k=0; k<queues.size(); ++k)
+    {
+      queue& q = *queues[(self+k) % queues.size()];
+      std::unique_lock<std::mutex> lock{q.lock};
+      if(q.tasks.empty()) continue;
+      task t;
+      if(k == 0)
+      {
+        t = std::move(q.tasks.back());
+        q.tasks.pop_back();
+      }
+      else
+      {
+        t = std::move(q.tasks.front());
+        q.tasks.pop_front();
+      }
+      lock.unlock();
+      --queued;
+      t();
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * \brief Destructor: the threads are stopped once the tasks that have been spawned are over.
+   */
+  ~task_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock{sleepLock};
+      stop = true;
+    }
+    wake.notify_all();
+    for(auto& w: workers)
+      w.join();
+  }
+};
+
+/**
+ * \brief Group of tasks spawned in a pool, whose end can be waited for.
+ *
+ * A thread waiting for the group runs the tasks of the pool meanwhile, so that it never blocks the tasks it waits for.
+ * If a task throws an exception, the first one is thrown again by wait.
+ */
+class task_group
+{
+  task_pool& pool;
+  std::atomic<std::size_t> left{0};
+  std::mutex errorLock;
+  std::exception_ptr error;
+
+public:
+
+  explicit task_group(task_pool& p) noexcept : pool{p} {}
+
+  task_group(const task_group&) = delete;
+  task_group& operator=(const task_group&) = delete;
+
+  /**
+   * \brief Function that spawns a task in the pool.
+   */
+  template<class F>
+  void spawn(F f)
+  {
+    ++left;
+    try
+    {
+      pool.push([this, f]()
+                {
+                  try
+                  {
+                    f();
+                  }
+                  catch(...)
+                  {
+                    std::lock_guard<std::mutex> lock{errorLock};
+                    if(!error) error = std::current_exception();
+                  }
+                  --left;
+                });
+    }
+    catch(...)
+    {
+      --left;
+      throw;
+    }
+  }
+
+  /**
+   * \brief Function that waits for the end of all the tasks of the group.
+   */
+  void wait()
+  {
+    while(left.load())
+      if(!pool.runOne())
+        std::this_thread::yield();
+    if(error)
+    {
+      std::exception_ptr e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+
+  /**
+   * \brief Destructor: it waits for the tasks, which refer to the group.
+   */
+  ~task_group()
+  {
+    while(left.load())
+      if(!pool.runOne())
+        std::this_thread::yield();
+  }
+};
+
+#endif
@@ -7,10 +7,45 @@
 #include<algorithm> //std::random_shuffle
 #include<chrono>
 #include<vector>
+#include<sstream> //std::ostringstream
+#include<cstring> //std::memcpy
+#include<thread>
+#include<mutex>
+#include<random> //std::mt19937
+#include<atomic>
+#include<array>
+#include<new> //operator new
+#include<cstdlib> //std::malloc
+#if __cplusplus >= 201703L
+#include<string_view>
+using string_view = std::string_view;
+#else
+#include<experimental/string_view> //the Makefile builds with C++14
+using string_view = std::experimental::string_view;
+#endif
 
 #include"BST.h"
+#include"BTree.h"
+#include"concurrent.h"
+#include"persistent.h"
+#include"sharded.h"
 
 int N = 20000;
+long hits = 0; //number of keys found by test, so that the searches cannot be optimized away
+//calls to operator new are counted only while counting is set, by the single-threaded string series:
+//the other series allocate as with the default operator new
+bool counting = false;
+long allocations = 0;
+
+void* operator new(std::size_t n)
+{
+  if(counting) ++allocations;
+  if(void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 //function used to time spent to search nsearch element in a container of type B
 template<class T, class V>
@@ -20,7 +55,7 @@ void test(std::ofstream& file, T& B, std::vector<V>& v)
     {
       auto begin =std::chrono::high_resolution_clock::now();
       for (int i=0u; i<nsearch; ++i)
-	B.find(v[i]);
+	hits += (B.find(v[i]) != B.end());
       auto end = std::chrono::high_resolution_clock::now();
       auto total = std::chrono::duration_cast<std::chrono::microseconds>(end-begin).count();
       file << total/double(nsearch) << "\n";
@@ -28,6 +63,807 @@ void test(std::ofstream& file, T& B, std::vector<V>& v)
 }
 
 
+//function used to time the insertion of n random keys in a tree of type T and its destruction
+template<class T>
+void test_alloc(std::ofstream& file)
+{
+  for(int n=1000; n<=(1<<20); n*=2)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      T B;
+      auto begin =std::chrono::high_resolution_clock::now();
+      for(auto x: keys)
+        B.insert({x,x});
+      auto middle = std::chrono::high_resolution_clock::now();
+      B.clear();
+      auto end = std::chrono::high_resolution_clock::now();
+      auto insert = std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count();
+      auto clear = std::chrono::duration_cast<std::chrono::microseconds>(end-middle).count();
+      file << n << " " << insert/double(n) << " " << clear << "\n";
+    }
+}
+
+//function used to time the deep copy of a tree of type T with n random keys
+template<class T>
+void test_copy(std::ofstream& file)
+{
+  for(int n=1000; n<=(1<<20); n*=2)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      T B;
+      for(auto x: keys)
+        B.insert({x,x});
+      auto begin =std::chrono::high_resolution_clock::now();
+      T C{B};
+      auto end = std::chrono::high_resolution_clock::now();
+      auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count();
+      file << n << " " << n/(total*1e-9) << "\n"; //copied nodes per second
+    }
+}
+
+//function used to time the construction of a tree from n sorted pairs, by bulk load and by insertion
+void test_bulk(std::ofstream& file)
+{
+  for(int n=1000; n<=(1<<23); n*=2)
+    {
+      std::vector<std::pair<int,int>> values(n);
+      for(int i=0; i<n; ++i)
+        values[i]={i,i};
+      auto begin =std::chrono::high_resolution_clock::now();
+      BST<int,int,std::less<int>,red_black> B{values.begin(), values.end()};
+      auto middle = std::chrono::high_resolution_clock::now();
+      BST<int,int,std::less<int>,red_black> C;
+      for(auto& x: values)
+        C.insert(x);
+      auto end = std::chrono::high_resolution_clock::now();
+      auto bulk = std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count();
+      auto insert = std::chrono::duration_cast<std::chrono::nanoseconds>(end-middle).count();
+      file << n << " " << bulk/double(n) << " " << insert/double(n) << "\n";
+    }
+}
+
+//function used to time the search of batches of random keys, with find_many and with find
+//the keys of a batch are drawn from a window of the given width (0 means the whole key space)
+void test_batch(std::ofstream& file, const int batch, const int window)
+{
+  for(int n=1<<12; n<=(1<<22); n*=4)
+    {
+      std::vector<std::pair<int,int>> values(n);
+      for(int i=0; i<n; ++i)
+        values[i]={2*i,i}; //half of the searched keys are missing
+      BST<int,int,std::less<int>,red_black> B{values.begin(), values.end()};
+      std::vector<std::vector<int>> batches(1000, std::vector<int>(batch));
+      const int width = (window && window < 2*n) ? window : 2*n;
+      for(auto& b: batches)
+        {
+          int base = std::rand()%(2*n-width+1);
+          for(auto& k: b)
+            k = base + std::rand()%width;
+        }
+      long found = 0;
+      auto begin =std::chrono::high_resolution_clock::now();
+      for(auto& b: batches)
+        for(auto& it: B.find_many(b))
+          found += (it != B.end());
+      auto middle = std::chrono::high_resolution_clock::now();
+      for(auto& b: batches)
+        for(auto k: b)
+          found += (B.find(k) != B.end());
+      auto end = std::chrono::high_resolution_clock::now();
+      auto many = std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count();
+      auto single = std::chrono::duration_cast<std::chrono::nanoseconds>(end-middle).count();
+      file << n << " " << many/double(1000*batch) << " " << single/double(1000*batch) << " " << found%2 << "\n";
+    }
+}
+
+//function used to measure the lookups per second of find and find_group, as the tree outgrows the caches
+void test_group(std::ofstream& file)
+{
+  using tree = BST<int,int,std::less<int>,red_black>;
+  const int lookups = 1<<20;
+  for(int n=1<<14; n<=(1<<23); n*=2) //from a few hundreds of KB (L2) to hundreds of MB (many times the LLC)
+    {
+      std::vector<std::pair<int,int>> values(n);
+      for(int i=0; i<n; ++i)
+        values[i]={2*i,i};
+      tree B{values.begin(), values.end()};
+      std::vector<int> keys(lookups);
+      for(auto& k: keys)
+        k = std::rand()%(2*n);
+      long found = 0;
+      file << n << " " << n*sizeof(tree::Node);
+      auto begin =std::chrono::high_resolution_clock::now();
+      for(auto k: keys)
+        found += (B.find(k) != B.end());
+      auto end = std::chrono::high_resolution_clock::now();
+      file << " " << lookups/(std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()*1e-9);
+      for(std::size_t width: {4, 8, 16})
+        {
+          begin =std::chrono::high_resolution_clock::now();
+          for(auto& it: B.find_group(keys, width))
+            found += (it != B.end());
+          end = std::chrono::high_resolution_clock::now();
+          file << " " << lookups/(std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()*1e-9);
+        }
+      file << " " << found%2 << "\n";
+    }
+}
+
+//function returning the average time (ns) of a random lookup in a container of type T filled with keys
+template<class T, class K>
+double lookup_time(const std::vector<K>& keys, const std::vector<K>& queries, long& found)
+{
+  T B;
+  for(auto x: keys)
+    B.insert({x,x});
+  auto begin =std::chrono::high_resolution_clock::now();
+  for(auto k: queries)
+    found += (B.find(k) != B.end());
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()/double(queries.size());
+}
+
+//function used to compare the lookups in BST, BTree, std::map and std::unordered_map as the containers outgrow the caches
+void test_btree(std::ofstream& file)
+{
+  for(int n=1<<10; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      std::vector<int> queries(1<<20);
+      for(auto& k: queries)
+        k = std::rand()%n;
+      long found = 0;
+      file << n
+           << " " << lookup_time<BST<int,int,std::less<int>,red_black>>(keys, queries, found)
+           << " " << lookup_time<BTree<int,int>>(keys, queries, found)
+           << " " << lookup_time<std::map<int,int>>(keys, queries, found)
+           << " " << lookup_time<std::unordered_map<int,int>>(keys, queries, found)
+           << " " << found%2 << "\n";
+    }
+}
+
+
+//comparison operator which is not std::less, so that BTree does not use the vector instructions
+template<class T>
+struct scalar_less
+{
+  bool operator()(const T& a, const T& b) const { return a < b; }
+};
+
+//function used to compare the lookups in BTree with scalar and vectorized search of the inner nodes, with int and double keys
+void test_simd(std::ofstream& file)
+{
+  for(int n=1<<10; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      std::vector<int> queries(1<<20);
+      for(auto& k: queries)
+        k = std::rand()%n;
+      std::vector<double> keys_d(keys.begin(), keys.end());
+      std::vector<double> queries_d(queries.begin(), queries.end());
+      for(auto& k: keys_d)
+        k = k*0.42+1.3;
+      for(auto& k: queries_d)
+        k = k*0.42+1.3;
+      long found = 0;
+      file << n
+           << " " << lookup_time<BTree<int,int,scalar_less<int>>>(keys, queries, found)
+           << " " << lookup_time<BTree<int,int>>(keys, queries, found)
+           << " " << lookup_time<BTree<double,int,scalar_less<double>>>(keys_d, queries_d, found)
+           << " " << lookup_time<BTree<double,int>>(keys_d, queries_d, found)
+           << " " << found%2 << "\n";
+    }
+}
+
+
+//function used to compare the lookups in a balanced tree and in its snapshot, and to time freeze, as the tree outgrows the caches
+void test_freeze(std::ofstream& file)
+{
+  for(int n=1<<12; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      std::vector<int> queries(1<<20);
+      for(auto& k: queries)
+        k = std::rand()%n;
+      BST<int,int> B;
+      for(auto x: keys)
+        B.insert({x,x});
+      B.Balance();
+      long found = 0;
+      auto begin = std::chrono::high_resolution_clock::now();
+      for(auto k: queries)
+        found += (B.find(k) != B.end());
+      auto middle = std::chrono::high_resolution_clock::now();
+      auto F = B.freeze();
+      auto frozen = std::chrono::high_resolution_clock::now();
+      for(auto k: queries)
+        found += (F.find(k) != F.end());
+      auto end = std::chrono::high_resolution_clock::now();
+      file << n
+           << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count()/double(queries.size())
+           << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(end-frozen).count()/double(queries.size())
+           << " " << std::chrono::duration_cast<std::chrono::microseconds>(frozen-middle).count()
+           << " " << found%2 << "\n";
+    }
+}
+
+
+//function used to compare the startup time of a tree rebuilt by insertion with the one of a snapshot mapped from a file
+void test_snapshot(std::ofstream& file)
+{
+  using tree = BST<int,int,std::less<int>,red_black>;
+  const std::string path = "test/snapshot.bin";
+  for(int n=1<<16; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      auto begin =std::chrono::high_resolution_clock::now();
+      tree B;
+      for(auto x: keys)
+        B.insert({x,x});
+      auto built = std::chrono::high_resolution_clock::now();
+      B.save(path);
+      auto saved = std::chrono::high_resolution_clock::now();
+      auto F = FrozenBST<int,int>::open(path);
+      auto opened = std::chrono::high_resolution_clock::now();
+      long found = 0;
+      for(int i=0; i<1000; ++i) //first lookups, which fault in the pages they touch
+        found += (F.find(keys[i]) != F.end());
+      auto end = std::chrono::high_resolution_clock::now();
+      file << n
+           << " " << std::chrono::duration_cast<std::chrono::microseconds>(built-begin).count()
+           << " " << std::chrono::duration_cast<std::chrono::microseconds>(saved-built).count()
+           << " " << std::chrono::duration_cast<std::chrono::microseconds>(opened-saved).count()
+           << " " << std::chrono::duration_cast<std::chrono::microseconds>(end-opened).count()
+           << " " << found%2 << "\n";
+    }
+  std::remove(path.c_str());
+}
+
+
+//function used to measure the throughput of serialize and deserialize, compared with the text output of operator<<
+void test_serialize(std::ofstream& file)
+{
+  using tree = BST<int,int,std::less<int>,red_black>;
+  for(int n=1<<16; n<=(1<<22); n*=4)
+    {
+      std::vector<std::pair<int,int>> values(n);
+      for(int i=0; i<n; ++i)
+        values[i]={3*i, std::rand()%1000};
+      tree B{values.begin(), values.end()};
+      std::string bytes;
+      auto begin =std::chrono::high_resolution_clock::now();
+      B.serialize([&bytes](const char* data, std::size_t size) { bytes.append(data, size); });
+      auto serialized = std::chrono::high_resolution_clock::now();
+      tree C;
+      std::size_t position = 0;
+      C.deserialize([&](char* data, std::size_t size)
+                    {
+                      size = std::min(size, bytes.size()-position);
+                      std::memcpy(data, bytes.data()+position, size);
+                      position += size;
+                      return size;
+                    });
+      auto deserialized = std::chrono::high_resolution_clock::now();
+      std::ostringstream text;
+      text << B;
+      auto end = std::chrono::high_resolution_clock::now();
+      double s = std::chrono::duration_cast<std::chrono::nanoseconds>(serialized-begin).count()*1e-9;
+      double d = std::chrono::duration_cast<std::chrono::nanoseconds>(deserialized-serialized).count()*1e-9;
+      double t = std::chrono::duration_cast<std::chrono::nanoseconds>(end-deserialized).count()*1e-9;
+      double raw = n*sizeof(std::pair<int,int>)*1e-9; //GB of pairs in memory
+      file << n << " " << bytes.size() << " " << raw/s << " " << raw/d << " " << raw/t << " " << (C.find(3)!=C.end()) << "\n";
+    }
+}
+
+//function used to run ops operations split among some threads, reads is the percentage of finds
+//and the writes are half insertions and half erasures of random keys; it returns millions of operations per second
+template<class F>
+double concurrent_throughput(const int threads, const int ops, const int reads, const int range, F op)
+{
+  std::vector<std::thread> pool;
+  auto begin =std::chrono::high_resolution_clock::now();
+  for(int t=0; t<threads; ++t)
+    pool.emplace_back([=]()
+                      {
+                        std::mt19937 gen(t+1);
+                        for(int i=0; i<ops/threads; ++i)
+                          {
+                            int r = gen()%100;
+                            op(r<reads ? 0 : (r%2 ? 1 : 2), int(gen()%range));
+                          }
+                      });
+  for(auto& t: pool)
+    t.join();
+  auto end = std::chrono::high_resolution_clock::now();
+  return ops/double(std::chrono::duration_cast<std::chrono::microseconds>(end-begin).count());
+}
+
+
+//function used to compare the concurrent tree with a red-black tree guarded by a mutex, for 1 to 8 threads and several read ratios
+void test_concurrent(std::ofstream& file)
+{
+  const int range = 1<<17, ops = 1<<20;
+  std::vector<int> keys(range);
+  for(int i=0; i<range; ++i)
+    keys[i]=i;
+  std::random_shuffle(keys.begin(), keys.end());
+  for(int reads: {100, 90, 50})
+    for(int threads=1; threads<=8; threads*=2)
+      {
+        ConcurrentBST<int,int> C;
+        BST<int,int,std::less<int>,red_black> B;
+        for(int i=0; i<range/2; ++i)
+          {
+            C.insert({keys[i],i});
+            B.insert({keys[i],i});
+          }
+        std::atomic<long> found{0};
+        double c = concurrent_throughput(threads, ops, reads, range, [&](int op, int k)
+                                         {
+                                           int v;
+                                           if(op==0) found += C.find(k, v);
+                                           else if(op==1) C.insert({k,k});
+                                           else C.erase(k);
+                                         });
+        std::mutex m;
+        double b = concurrent_throughput(threads, ops, reads, range, [&](int op, int k)
+                                         {
+                                           std::lock_guard<std::mutex> lock{m};
+                                           bool in = B.find(k)!=B.end();
+                                           if(op==0) found += in;
+                                           else if(op==1) B.insert({k,k});
+                                           else if(in) B.erase(k);
+                                         });
+        hits += found;
+        file << threads << " " << reads << " " << c << " " << b << "\n";
+      }
+}
+
+//function used to measure the cost of the updates of the persistent tree, against the insertions in a red-black tree
+void test_persistent_write(std::ofstream& file)
+{
+  for(int n=1<<12; n<=(1<<20); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::random_shuffle(keys.begin(), keys.end());
+      PersistentBST<int,int> P;
+      BST<int,int,std::less<int>,red_black> B;
+      auto begin =std::chrono::high_resolution_clock::now();
+      for(auto x: keys)
+        P.insert({x,x});
+      auto inserted = std::chrono::high_resolution_clock::now();
+      for(auto x: keys)
+        B.insert({x,x});
+      auto rb = std::chrono::high_resolution_clock::now();
+      for(int i=0; i<n; i+=2)
+        P.erase(keys[i]);
+      auto end = std::chrono::high_resolution_clock::now();
+      file << n << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(inserted-begin).count()/double(n)
+           << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(end-rb).count()/double(n/2)
+           << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(rb-inserted).count()/double(n)
+           << " " << P.size() << "\n";
+    }
+}
+
+
+//function used to measure the throughput of readers looking up keys in snapshots, with and without a concurrent writer
+void test_persistent_read(std::ofstream& file)
+{
+  const int range = 1<<17, ops = 1<<20;
+  for(int readers=1; readers<=4; readers*=2)
+    for(int writing=0; writing<=1; ++writing)
+      {
+        PersistentBST<int,int> P;
+        std::vector<int> keys(range);
+        for(int i=0; i<range; ++i)
+          keys[i]=i;
+        std::random_shuffle(keys.begin(), keys.end());
+        for(int i=0; i<range/2; ++i)
+          P.insert({keys[i],i});
+        std::atomic<bool> stop{false};
+        std::atomic<long> found{0}, updates{0};
+        std::thread writer;
+        if(writing)
+          writer = std::thread{[&]()
+                               {
+                                 std::mt19937 gen(0);
+                                 while(!stop)
+                                   {
+                                     int k = gen()%range;
+                                     if(gen()%2) P.insert({k,k});
+                                     else P.erase(k);
+                                     ++updates;
+                                   }
+                               }};
+        std::vector<std::thread> pool;
+        auto begin =std::chrono::high_resolution_clock::now();
+        for(int t=0; t<readers; ++t)
+          pool.emplace_back([&,t]()
+                            {
+                              std::mt19937 gen(t+1);
+                              long f = 0;
+                              for(int i=0; i<ops/readers; i+=1024)
+                                {
+                                  auto s = P.current(); //a new snapshot every 1024 lookups
+                                  for(int j=0; j<1024; ++j)
+                                    f += s.find(gen()%range) != s.end();
+                                }
+                              found += f;
+                            });
+        for(auto& t: pool)
+          t.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        stop = true;
+        if(writing)
+          writer.join();
+        hits += found;
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end-begin).count()*1e-6;
+        file << readers << " " << writing << " " << ops/seconds*1e-6 << " " << updates/seconds*1e-6 << "\n";
+      }
+}
+
+//function used to compare the sharded map with a red-black tree guarded by a mutex, for 1 to 8 threads and several read ratios
+void test_sharded(std::ofstream& file)
+{
+  const int range = 1<<18, ops = 1<<20;
+  std::vector<std::pair<int,int>> values(range/2);
+  for(int i=0; i<range/2; ++i)
+    values[i]={2*i,i};
+  for(int reads: {100, 90, 50})
+    for(int threads=1; threads<=8; threads*=2)
+      {
+        ShardedBST<int,int> S{values.begin(), values.end()};
+        BST<int,int,std::less<int>,red_black> B{values.begin(), values.end()};
+        std::atomic<long> found{0};
+        double s = concurrent_throughput(threads, ops, reads, range, [&](int op, int k)
+                                         {
+                                           int v;
+                                           if(op==0) found += S.find(k, v);
+                                           else if(op==1) S.insert({k,k});
+                                           else S.erase(k);
+                                         });
+        std::mutex m;
+        double b = concurrent_throughput(threads, ops, reads, range, [&](int op, int k)
+                                         {
+                                           std::lock_guard<std::mutex> lock{m};
+                                           bool in = B.find(k)!=B.end();
+                                           if(op==0) found += in;
+                                           else if(op==1) B.insert({k,k});
+                                           else if(in) B.erase(k);
+                                         });
+        hits += found;
+        file << threads << " " << reads << " " << s << " " << b << "\n";
+      }
+}
+
+
+//function used to time the copy and the Balance of a random tree of 10M keys with 1 to 16 threads
+void test_parallel(std::ofstream& file)
+{
+  const int n = 10000000;
+  std::vector<int> keys(n);
+  for(int i=0; i<n; ++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  BST<int,int> B;
+  for(auto x: keys)
+    B.insert({x,x});
+  //the speedup depends on the cores of the machine, which are recorded with the times
+  file << "# hardware threads: " << std::thread::hardware_concurrency() << "\n";
+  for(int threads=1; threads<=16; threads*=2)
+    {
+      auto begin = std::chrono::high_resolution_clock::now();
+      BST<int,int> C{B, std::size_t(threads)};
+      auto middle = std::chrono::high_resolution_clock::now();
+      C.Balance(threads);
+      auto end = std::chrono::high_resolution_clock::now();
+      auto copy = std::chrono::duration_cast<std::chrono::milliseconds>(middle-begin).count();
+      auto balance = std::chrono::duration_cast<std::chrono::milliseconds>(end-middle).count();
+      file << threads << " " << copy << " " << balance << "\n";
+    }
+}
+
+
+//function used to time a sum of the values and a count with 1 to 16 threads, against a loop with the iterators
+void test_parallel_scan(std::ofstream& file)
+{
+  const int n = 1<<23;
+  std::vector<int> keys(n);
+  for(int i=0; i<n; ++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  BST<int,int,std::less<int>,red_black> B;
+  for(auto x: keys)
+    B.insert({x,x});
+  using pair = std::pair<const int,int>;
+  auto begin = std::chrono::high_resolution_clock::now();
+  long sum = 0;
+  for(auto& x: B)
+    sum += x.second;
+  auto end = std::chrono::high_resolution_clock::now();
+  hits += sum;
+  auto loop = std::chrono::duration_cast<std::chrono::microseconds>(end-begin).count();
+  for(std::size_t threads=1; threads<=16; threads*=2)
+    {
+      begin = std::chrono::high_resolution_clock::now();
+      hits += B.parallel_reduce(0L, [](long a, long b) { return a+b; }, [](const pair& x) { return long(x.second); }, threads);
+      auto middle = std::chrono::high_resolution_clock::now();
+      hits += B.parallel_count_if([](const pair& x) { return x.second%3 == 0; }, threads);
+      end = std::chrono::high_resolution_clock::now();
+      auto reduce = std::chrono::duration_cast<std::chrono::microseconds>(middle-begin).count();
+      auto count = std::chrono::duration_cast<std::chrono::microseconds>(end-middle).count();
+      file << threads << " " << loop << " " << reduce << " " << count << "\n";
+    }
+}
+
+
+//function used to time the percentiles of a tree, with select and with the iterators
+void test_select(std::ofstream& file)
+{
+  for(int n=1<<12; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+      BST<int,int,std::less<int>,order_statistics<red_black>> B;
+      BST<int,int,std::less<int>,red_black> C;
+      for(auto x: keys)
+        {
+          B.insert({x,x});
+          C.insert({x,x});
+        }
+      auto begin = std::chrono::high_resolution_clock::now();
+      for(int p=1; p<100; ++p) //the 99 percentiles
+        hits += B.select(std::size_t(n)*p/100)->first;
+      auto middle = std::chrono::high_resolution_clock::now();
+      auto it = C.begin();
+      for(int i=0, p=1; p<100; ++it, ++i)
+        if(i == n*long(p)/100)
+          {
+            hits += it->first;
+            ++p;
+          }
+      auto end = std::chrono::high_resolution_clock::now();
+      auto select = std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count();
+      auto walk = std::chrono::duration_cast<std::chrono::nanoseconds>(end-middle).count();
+      file << n << " " << select << " " << walk << "\n";
+    }
+}
+
+
+//function used to time the scan of ranges of keys of increasing width, with range and with std::map
+void test_range(std::ofstream& file)
+{
+  const int n = 1<<20, queries = 1000;
+  std::vector<int> keys(n);
+  for(int i=0; i<n; ++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  BST<int,int,std::less<int>,red_black> B;
+  std::map<int,int> M;
+  for(auto x: keys)
+    {
+      B.insert({x,x});
+      M.insert({x,x});
+    }
+  std::mt19937 gen{7};
+  for(int width=1; width<=(1<<16); width*=16)
+    {
+      std::vector<int> lo(queries);
+      for(auto& x: lo)
+        x = gen()%n;
+      auto begin = std::chrono::high_resolution_clock::now();
+      for(auto x: lo)
+        for(auto& p: B.range(x, x+width))
+          hits += p.second;
+      auto middle = std::chrono::high_resolution_clock::now();
+      for(auto x: lo)
+        for(auto it = M.lower_bound(x), last = M.lower_bound(x+width); it != last; ++it)
+          hits += it->second;
+      auto end = std::chrono::high_resolution_clock::now();
+      auto bst = std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count();
+      auto map = std::chrono::duration_cast<std::chrono::nanoseconds>(end-middle).count();
+      file << width << " " << bst/double(queries) << " " << map/double(queries) << "\n";
+    }
+}
+
+
+//function used to time a full scan of a tree of type T, in ns per element
+template<class T>
+double scan_time(const T& B, const int n)
+{
+  auto begin = std::chrono::high_resolution_clock::now();
+  long sum = 0;
+  for(auto& x: B)
+    sum += x.second;
+  auto end = std::chrono::high_resolution_clock::now();
+  hits += sum;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()/double(n);
+}
+
+//function used to compare the full scan of a red-black tree, of a threaded red-black tree and of a map
+void test_scan(std::ofstream& file)
+{
+  for(int n=1<<12; n<=(1<<22); n*=4)
+    {
+      std::vector<int> keys(n);
+      for(int i=0; i<n; ++i)
+        keys[i]=i;
+      std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+      BST<int,int,std::less<int>,red_black> B;
+      BST<int,int,std::less<int>,threaded<red_black>> T;
+      std::map<int,int> M;
+      for(auto x: keys)
+        {
+          B.insert({x,x});
+          T.insert({x,x});
+          M.insert({x,x});
+        }
+      file << n << " " << scan_time(B, n) << " " << scan_time(T, n) << " " << scan_time(M, n) << "\n";
+    }
+}
+
+
+//function used to time the N biggest keys of a tree, with the reverse iterators and with a forward scan
+void test_topn(std::ofstream& file)
+{
+  const int n = 1<<20;
+  const std::size_t top = 100;
+  std::vector<int> keys(n);
+  for(int i=0; i<n; ++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  BST<int,int,std::less<int>,red_black> B;
+  for(auto x: keys)
+    B.insert({x,x});
+  auto begin = std::chrono::high_resolution_clock::now();
+  std::size_t i = 0;
+  for(auto it = B.rbegin(); it != B.rend() && i < top; ++it, ++i)
+    hits += it->first;
+  auto middle = std::chrono::high_resolution_clock::now();
+  std::vector<int> last(top); //circular buffer with the last keys of the scan
+  i = 0;
+  for(auto& x: B)
+    last[i++ % top] = x.first;
+  for(auto x: last)
+    hits += x;
+  auto end = std::chrono::high_resolution_clock::now();
+  file << std::chrono::duration_cast<std::chrono::nanoseconds>(middle-begin).count() << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(end-middle).count() << "\n";
+}
+
+//time spent to move 1M pairs to another tree: copying and erasing them, extracting and inserting the nodes, merging the trees,
+//and to split a tree in two halves and join them again
+void test_node_handle(std::ofstream& file)
+{
+  using Tree = BST<int,int,std::less<int>,red_black>;
+  const int n = 1<<20;
+  std::vector<int> keys(n);
+  for(int i=0; i<n; ++i)
+    keys[i]=i;
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+  Tree A, C;
+  for(auto x: keys)
+    A.insert({x,x});
+  C = A;
+  Tree B, D, E;
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for(auto x: keys)
+    {
+      auto it = A.find(x);
+      B.insert(*it);
+      A.erase(x);
+    }
+  auto t1 = std::chrono::high_resolution_clock::now();
+  for(auto x: keys)
+    D.insert(B.extract(x));
+  auto t2 = std::chrono::high_resolution_clock::now();
+  E.merge(D);
+  auto t3 = std::chrono::high_resolution_clock::now();
+  Tree R = C.split(n/2);
+  auto t4 = std::chrono::high_resolution_clock::now();
+  C.join(std::move(R));
+  auto t5 = std::chrono::high_resolution_clock::now();
+  hits += E.begin()->first + C.begin()->first;
+  file << std::chrono::duration_cast<std::chrono::microseconds>(t1-t0).count() << " "
+       << std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count() << " "
+       << std::chrono::duration_cast<std::chrono::microseconds>(t3-t2).count() << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(t4-t3).count() << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(t5-t4).count() << "\n";
+}
+//time and allocations per lookup of std::string keys given as another type
+template<class T, class P>
+void string_lookups(std::ofstream& file, const std::vector<std::string>& keys, const std::vector<P>& probes)
+{
+  T B;
+  for(std::size_t i=0; i<keys.size(); ++i)
+    B.insert({keys[i], int(i)});
+  allocations = 0;
+  counting = true;
+  auto begin = std::chrono::high_resolution_clock::now();
+  for(auto p: probes)
+    hits += B.find(p) != B.end();
+  auto end = std::chrono::high_resolution_clock::now();
+  counting = false;
+  file << std::chrono::duration_cast<std::chrono::nanoseconds>(end-begin).count()/double(probes.size()) << " "
+       << allocations/double(probes.size()) << " ";
+}
+
+void test_string_lookup(std::ofstream& file, const std::size_t n)
+{
+  const std::size_t nprobes = 1<<20;
+  std::mt19937 gen{42};
+  std::vector<std::string> keys(n);
+  for(std::size_t i=0; i<n; ++i)
+    keys[i] = "key-number-" + std::to_string(1000000+gen()%9000000); //longer than the small string buffer
+  std::vector<const char*> probes(nprobes);
+  for(auto& p: probes)
+    p = keys[gen()%n].c_str();
+  std::vector<string_view> views(probes.begin(), probes.end());
+  //const char* converted to std::string, const char* compared directly, string_view compared directly
+  string_lookups<BST<std::string,int,std::less<std::string>,red_black>>(file, keys, probes);
+  string_lookups<BST<std::string,int,std::less<>,red_black>>(file, keys, probes);
+  string_lookups<BST<std::string,int,std::less<>,red_black>>(file, keys, views);
+  file << "\n";
+}
+//time per append of increasing keys without and with a hint, and per operator[] with a big value type, building the
+//value before the search (as insert does) and with try_emplace
+void test_hint(std::ofstream& file)
+{
+  using Clock = std::chrono::high_resolution_clock;
+  const int n = 1<<20;
+  BST<int,int,std::less<int>,red_black> A, B;
+  auto t0 = Clock::now();
+  for(int i=0; i<n; ++i)
+    A.insert({i,i});
+  auto t1 = Clock::now();
+  for(int i=0; i<n; ++i)
+    B.insert(B.end(), {i,i});
+  auto t2 = Clock::now();
+  hits += A.begin()->second + B.begin()->second;
+  using Big = std::array<double,64>;
+  const int keys = 1<<12;
+  const int ops = 1<<22;
+  std::vector<int> probes(ops);
+  std::mt19937 gen{42};
+  for(auto& x: probes)
+    x = gen()%keys;
+  BST<int,Big,std::less<int>,red_black> C, D;
+  auto t3 = Clock::now();
+  for(auto x: probes)
+    C.insert({x, Big{}}).first->second[0] += 1;
+  auto t4 = Clock::now();
+  for(auto x: probes)
+    D[x][0] += 1;
+  auto t5 = Clock::now();
+  hits += C.begin()->second[0] + D.begin()->second[0];
+  file << std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count()/double(n) << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count()/double(n) << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(t4-t3).count()/double(ops) << " "
+       << std::chrono::duration_cast<std::chrono::nanoseconds>(t5-t4).count()/double(ops) << "\n";
+}
+
 int main()
 {
   /** comparison of the time to find some elements */
@@ -38,7 +874,6 @@ int main()
 
   //key is int
   BST<int,int> bst_int; //non balanced random tree
-  BST<int,int> bst_int_b; //balanced tree
 
   std::vector<int> ordered_int(N);
   for(int i=0; i<N; ++i)
@@ -60,16 +895,170 @@ int main()
   test(file, bst_int, random_int);
   file.close();}
 
+  //timing the in-place balance
+  auto bbegin = std::chrono::high_resolution_clock::now();
   bst_int.Balance();
+  auto bend = std::chrono::high_resolution_clock::now();
+  file.open("test/balance_time.txt");
+  file << std::chrono::duration_cast<std::chrono::microseconds>(bend-bbegin).count() << "\n";
+  file.close();
   
   for(int i=1; i<=5; ++i) 
   {file.open("test/balanced_int_"+std::to_string(i)+".txt");
-  test(file, bst_int_b, random_int);
+  test(file, bst_int, random_int);
   file.close();}
 
+  //immutable snapshot of the balanced tree in Eytzinger order
+  auto frozen_int = bst_int.freeze();
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/frozen_int_"+std::to_string(i)+".txt");
+  test(file, frozen_int, random_int);
+  file.close();}
+
+  //red-black tree filled in increasing key order, the worst case for the plain tree
+  BST<int,int,std::less<int>,red_black> bst_rb;
+  for(auto x: ordered_int)
+    bst_rb.insert({x,x});
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/redblack_int_"+std::to_string(i)+".txt");
+  test(file, bst_rb, random_int);
+  file.close();}
+
+  //heap allocated nodes against nodes allocated by node_pool
+  for(int i=1; i<=5; ++i)
+  {file.open("test/heap_alloc_"+std::to_string(i)+".txt");
+  test_alloc<BST<int,int,std::less<int>,red_black>>(file);
+  file.close();}
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/pool_alloc_"+std::to_string(i)+".txt");
+  test_alloc<BST<int,int,std::less<int>,red_black,node_pool<std::pair<const int,int>>>>(file);
+  file.close();}
+
+  //throughput of the copy constructor
+  for(int i=1; i<=5; ++i)
+  {file.open("test/heap_copy_"+std::to_string(i)+".txt");
+  test_copy<BST<int,int,std::less<int>,red_black>>(file);
+  file.close();}
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/pool_copy_"+std::to_string(i)+".txt");
+  test_copy<BST<int,int,std::less<int>,red_black,node_pool<std::pair<const int,int>>>>(file);
+  file.close();}
+
+  //startup time: bulk load against insertion of sorted pairs
+  file.open("test/bulk_load.txt");
+  test_bulk(file);
+  file.close();
+
+  //batches of lookups
+  file.open("test/batch_find_random.txt");
+  test_batch(file, 256, 0);
+  file.close();
+
+  file.open("test/batch_find_window.txt");
+  test_batch(file, 256, 4096);
+  file.close();
+
+  //interleaved lookups with prefetching
+  file.open("test/group_find.txt");
+  test_group(file);
+  file.close();
+
+  //B+ tree against BST, std::map and std::unordered_map
+  file.open("test/btree_find.txt");
+  test_btree(file);
+  file.close();
+
+  //vectorized search of the nodes of the B+ tree
+  file.open("test/simd_find.txt");
+  test_simd(file);
+  file.close();
+
+  //balanced tree against its snapshot in Eytzinger order
+  file.open("test/freeze.txt");
+  test_freeze(file);
+  file.close();
+
+  //startup: insertion against a snapshot mapped from a file
+  file.open("test/snapshot.txt");
+  test_snapshot(file);
+  file.close();
+
+  //binary serialization
+  file.open("test/serialize.txt");
+  test_serialize(file);
+  file.close();
+
+  //concurrent tree against a tree guarded by a mutex
+  file.open("test/concurrent.txt");
+  test_concurrent(file);
+  file.close();
+
+  //persistent tree: cost of the updates and readers of snapshots under a writer
+  file.open("test/persistent_write.txt");
+  test_persistent_write(file);
+  file.close();
+
+  file.open("test/persistent_read.txt");
+  test_persistent_read(file);
+  file.close();
+
+  //sharded map against a tree guarded by a mutex
+  file.open("test/sharded.txt");
+  test_sharded(file);
+  file.close();
+
+  //parallel copy and Balance
+  file.open("test/parallel.txt");
+  test_parallel(file);
+  file.close();
+
+  //parallel reductions
+  file.open("test/parallel_scan.txt");
+  test_parallel_scan(file);
+  file.close();
+
+  //percentiles with select
+  file.open("test/select.txt");
+  test_select(file);
+  file.close();
+
+  //range queries against std::map
+  file.open("test/range.txt");
+  test_range(file);
+  file.close();
+
+  //full scans of threaded trees
+  file.open("test/scan.txt");
+  test_scan(file);
+  file.close();
+
+  //N biggest keys with the reverse iterators
+  file.open("test/topn.txt");
+  test_topn(file);
+  file.close();
+
+  //moving nodes between trees
+  file.open("test/node_handle.txt");
+  test_node_handle(file);
+  file.close();
+
+  //lookups of string keys without temporary keys
+  file.open("test/string_lookup.txt");
+  for(std::size_t n=1<<8; n<=1<<20; n<<=4)
+    test_string_lookup(file, n);
+  file.close();
+
+  //hinted appends and operator[] with try_emplace
+  file.open("test/hint.txt");
+  test_hint(file);
+  file.close();
+
   //key is double
   BST<double,int> bst_d; //non balanced random tree
-  BST<double,int> bst_d_b; //balanced tree
 
   std::vector<double> ordered_d(N);
   for(int i=0; i<N; ++i)
@@ -94,7 +1083,14 @@ int main()
 
   for(int i=1; i<=5; ++i)
   {file.open("test/balanced_double_"+std::to_string(i)+".txt");
-  test(file, bst_d_b, random_d);
+  test(file, bst_d, random_d);
+  file.close();}
+
+  auto frozen_d = bst_d.freeze();
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/frozen_double_"+std::to_string(i)+".txt");
+  test(file, frozen_d, random_d);
   file.close();}
 
   //maps
@@ -116,5 +1112,15 @@ int main()
   {file.open("test/umap_"+std::to_string(i)+".txt");
   test(file, umap, ordered_int);
   file.close();}
+
+  //timing B+ tree
+  BTree<int,int> btree;
+  for(auto x: random_int)
+    btree.insert({x,x});
+
+  for(int i=1; i<=5; ++i)
+  {file.open("test/btree_int_"+std::to_string(i)+".txt");
+  test(file, btree, random_int);
+  file.close();}
   
 }
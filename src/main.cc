@@ -1,4 +1,9 @@
 #include"BST.h"
+#include"BTree.h"
+#include"concurrent.h"
+#include"persistent.h"
+#include"sharded.h"
+#include<thread>
 
 
 int main()
@@ -149,6 +154,172 @@ int main()
   std::cout<<std::endl;
    
   
+  /** testing the range constructor */
+  std::vector<std::pair<int,int>> sorted{{1,1},{2,2},{3,3},{4,4},{5,5}};
+  BST<int,int> bulk{sorted.begin(), sorted.end()};
+  std::cout << "Tree built from a sorted range: " << std::endl;
+  std::cout << bulk;
+  std::cout << std::endl;
+  std::vector<std::pair<int,int>> unsorted{{4,4},{2,2},{5,5},{2,0},{1,1}};
+  bulk.assign(unsorted.begin(), unsorted.end());
+  std::cout << "Tree built from an unsorted range (expected 1 2 4 5, [2]=2): " << std::endl;
+  std::cout << bulk;
+  std::cout << std::endl;
+
+  /** testing the red-black policy */
+  BST<int,int,std::less<int>,red_black> rb;
+  for(int i=0; i<10; ++i)
+    rb.insert({i,i}); //sorted insertion, the tree balances itself
+  std::cout << "Red-black tree: " << std::endl;
+  std::cout << rb;
+  std::cout << std::endl;
+  rb.erase(3);
+  rb.erase(0);
+  std::cout << rb;
+  std::cout << std::endl;
+
+  /** testing freeze */
+  auto frozen = rb.freeze();
+  std::cout << "Frozen red-black tree: " << std::endl;
+  std::cout << frozen;
+  std::cout << std::endl;
+  std::cout << "find(5): " << frozen.find(5)->second << ", first key not smaller than 3: " << frozen.lower_bound(3)->first << std::endl;
+
+  /** testing the B+ tree */
+  BTree<int,int,std::less<int>,4,4> btree; //small nodes, so that they are split and merged
+  for(int i=0; i<50; ++i)
+    btree.insert({(i*7)%50,i});
+  for(int i=0; i<50; i+=2)
+    btree.erase(i);
+  btree[100] = 100;
+  std::cout << "B+ tree (odd keys up to 49, then 100): " << std::endl;
+  std::cout << btree;
+  std::cout << std::endl;
+
+  /** testing the concurrent tree */
+  ConcurrentBST<int,int> ctree;
+  std::vector<std::thread> writers;
+  for(int t=0; t<4; ++t) //every thread inserts the keys k with k%4==t, then erases the multiples of 8
+    writers.emplace_back([&ctree,t]()
+                         {
+                           for(int k=t; k<40; k+=4)
+                             ctree.insert({k,k});
+                           for(int k=t; k<40; k+=4)
+                             if(k%8==0) ctree.erase(k);
+                         });
+  for(auto& w: writers)
+    w.join();
+  std::cout << "Concurrent tree (keys up to 39, without the multiples of 8): " << std::endl;
+  std::cout << ctree;
+  std::cout << std::endl;
+
+  /** testing the persistent tree */
+  PersistentBST<int,int> ptree;
+  for(int i=0; i<10; ++i)
+    ptree.insert({i,i});
+  auto before = ptree.current(); //it does not see the next updates
+  for(int i=0; i<10; i+=2)
+    ptree.erase(i);
+  std::cout << "Persistent tree, snapshot before the erasures: " << std::endl;
+  std::cout << before << std::endl;
+  std::cout << "Persistent tree, current version: " << std::endl;
+  std::cout << ptree << std::endl;
+
+  /** testing the sharded map */
+  std::vector<std::pair<int,int>> spairs;
+  for(int i=0; i<20; ++i)
+    spairs.push_back({(i*7)%20,i});
+  ShardedBST<int,int,std::less<int>,4> smap{spairs.begin(), spairs.end()};
+  smap.erase(0);
+  smap.insert({20,20});
+  smap.Balance();
+  std::cout << "Sharded map (keys from 1 to 20, in 4 shards): " << std::endl;
+  std::cout << smap << std::endl;
+
+  /** testing the parallel copy and Balance */
+  BST<int,int,std::less<int>,red_black> ptree2;
+  for(int i=0; i<20; ++i)
+    ptree2.insert({(i*7)%20,i});
+  BST<int,int,std::less<int>,red_black> pcopy{ptree2, 4};
+  pcopy.Balance(4);
+  std::cout << "Copied and balanced with 4 threads: " << std::endl;
+  std::cout << pcopy << std::endl;
+
+  /** testing the parallel algorithms */
+  pcopy.parallel_for_each([](std::pair<const int,int>& x) { x.second *= 10; }, 4);
+  std::cout << "Values multiplied by 10 with 4 threads: " << std::endl;
+  std::cout << pcopy << std::endl;
+  std::cout << "Sum of the values: " << pcopy.parallel_reduce(0, [](int a, int b) { return a+b; }, [](const std::pair<const int,int>& x) { return x.second; }, 4) << std::endl;
+  std::cout << "Keys in order: " << pcopy.parallel_reduce(std::string{}, [](std::string a, const std::string& b) { return a+b; }, [](const std::pair<const int,int>& x) { return std::to_string(x.first)+" "; }, 4) << std::endl;
+  std::cout << "Even keys: " << pcopy.parallel_count_if([](const std::pair<const int,int>& x) { return x.first%2 == 0; }, 4) << std::endl;
+
+  /** testing the order statistics */
+  BST<int,int,std::less<int>,order_statistics<red_black>> otree;
+  for(int i=0; i<20; ++i)
+    otree.insert({(i*7)%20,i});
+  otree.erase(0);
+  std::cout << "Order statistics tree: " << std::endl;
+  std::cout << otree << std::endl;
+  std::cout << "Size: " << otree.size() << ", median: " << otree.select(otree.size()/2)->first
+            << ", rank of 10: " << otree.rank(10) << ", keys in [5,15): " << otree.count_range(5,15)
+            << ", 5 keys after the median: " << otree.advance(otree.select(otree.size()/2), 5)->first << std::endl;
+
+  /** testing the range queries */
+  std::cout << "Lower bound of 10: " << otree.lower_bound(10)->first << ", upper bound of 10: " << otree.upper_bound(10)->first
+            << ", equal range of 0 is empty: " << (otree.equal_range(0).first == otree.equal_range(0).second) << std::endl;
+  std::cout << "Keys in [5,9): ";
+  for(auto& x: otree.range(5,9))
+    std::cout << x.first << " ";
+  std::cout << std::endl;
+
+  /** testing the threaded tree */
+  BST<int,int,std::less<int>,threaded<red_black>> ttree;
+  for(int i=0; i<20; ++i)
+    ttree.insert({(i*7)%20,i});
+  ttree.erase(0);
+  ttree.erase(13);
+  std::cout << "Threaded tree: " << std::endl;
+  std::cout << ttree << std::endl;
+
+  /** testing the reverse iterators */
+  std::cout << "Threaded tree in descending order: " << std::endl;
+  for(auto it = ttree.rbegin(); it != ttree.rend(); ++it)
+    std::cout << it->first << ":" << it->second << "    ";
+  std::cout << std::endl;
+  std::cout << "Biggest key of the order statistics tree: " << (--otree.end())->first << std::endl;
+
+  /** testing the node handles */
+  auto handle = ttree.extract(7);
+  handle.mapped() = 70;
+  BST<int,int,std::less<int>,threaded<red_black>> ttree2;
+  ttree2.insert(std::move(handle));
+  std::cout << "Node moved to another tree: " << ttree2 << std::endl;
+  auto upper = ttree.split(10);
+  std::cout << "Keys smaller than 10: " << ttree << std::endl;
+  std::cout << "Keys not smaller than 10: " << upper << std::endl;
+  ttree.join(std::move(upper));
+  ttree.merge(ttree2);
+  std::cout << "Joined and merged again: " << ttree << std::endl;
+
+  /** testing the lookups with a transparent comparator */
+  BST<std::string,int,std::less<>> stree;
+  stree.insert({"alpha",1});
+  stree.insert({"beta",2});
+  stree.insert({"gamma",3});
+  const char* name = "beta";
+  std::cout << "Value of " << name << ": " << stree.find(name)->second << std::endl;
+  std::cout << "Contains delta: " << stree.contains("delta") << std::endl;
+  stree.erase("alpha");
+  std::cout << "First key after erase: " << stree.lower_bound("a")->first << std::endl;
+
+  /** testing try_emplace, insert_or_assign and the hinted insertions */
+  auto emplaced = stree.try_emplace("gamma", 30);
+  std::cout << "try_emplace on gamma inserted: " << emplaced.second << ", value " << emplaced.first->second << std::endl;
+  stree.insert_or_assign("gamma", 30);
+  stree.emplace_hint(stree.end(), "omega", 24);
+  stree.insert(stree.lower_bound("beta"), {"alpha", 1});
+  std::cout << "String tree: " << stree << std::endl;
+
   /** testing balance */
   #ifdef PRINT
   std::cout << "Non balanced tree:" << std::endl;